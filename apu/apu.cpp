@@ -11,6 +11,7 @@
 #include "../msu1.h"
 #include "../snapshot.h"
 #include "../display.h"
+#include "../perfcounters.h"
 #include "resampler.h"
 
 #include "bapu/snes/snes.hpp"
@@ -108,6 +109,40 @@ bool8 S9xMixSamples(uint8 *dest, int sample_count)
     return true;
 }
 
+// Without resampling or MSU-1 mixing the DSP output is already what the
+// frontend wants, so it can be handed out where it lies. Returns the number of
+// samples stored contiguously at *data, or -1 if they have to be fetched with
+// S9xMixSamples.
+int S9xPeekSamples(int16 **data)
+{
+    int sample_count;
+
+    if (Settings.Mute || Settings.MSU1 || spc::resampler.r_step != 1.0)
+        return -1;
+
+    *data = spc::resampler.peek(sample_count);
+    if (sample_count < spc::resampler.space_filled())
+        return -1;
+
+    return sample_count;
+}
+
+// Drops samples obtained from S9xPeekSamples. Once the buffer runs empty it
+// starts over at its beginning, so a caller that takes everything each frame
+// keeps getting one contiguous block. Only for frontends that produce and
+// consume samples on the same thread.
+void S9xReleaseSamples(int sample_count)
+{
+    spc::resampler.dump(sample_count);
+    spc::resampler.rewind();
+
+    if (spc::resampler.space_empty() >= 535 * 2 || !Settings.SoundSync ||
+        Settings.TurboMode || Settings.Mute)
+        spc::sound_in_sync = true;
+    else
+        spc::sound_in_sync = false;
+}
+
 int S9xGetSampleCount(void)
 {
 	int avail = spc::resampler.avail();
@@ -270,11 +305,16 @@ void S9xAPUSetReferenceTime(int32 cpucycles)
 
 void S9xAPUExecute(void)
 {
+    S9xPerfAdd(PERF_APU_CATCHUPS, 1);
+
     int cycles = S9xAPUGetClock(CPU.Cycles);
     spc::remainder = S9xAPUGetClockRemainder(CPU.Cycles);
     SNES::smp.clock -= cycles;
     SNES::smp.enter();
 
+    S9xPerfAdd(PERF_SMP_SKIPPED_CYCLES, SNES::smp.idle_skipped);
+    SNES::smp.idle_skipped = 0;
+
     S9xAPUSetReferenceTime(CPU.Cycles);
 }
 
@@ -344,11 +384,11 @@ void S9xAPUSaveState(uint8 *block)
     memset(ptr, 0, SPC_SAVE_STATE_BLOCK_SIZE - (ptr - block));
 }
 
-void S9xAPULoadState(uint8 *block)
+static void LoadState(uint8 *block, bool ram)
 {
     uint8 *ptr = block;
 
-    SNES::smp.load_state(&ptr);
+    SNES::smp.load_state(&ptr, ram);
     SNES::dsp.load_state(&ptr);
     spc::reference_time = SNES::get_le32(ptr);
     ptr += sizeof(int32);
@@ -359,6 +399,34 @@ void S9xAPULoadState(uint8 *block)
     memcpy(SNES::cpu.registers, ptr, 4);
 }
 
+void S9xAPULoadState(uint8 *block)
+{
+    LoadState(block, true);
+}
+
+void S9xAPUSaveGolden(uint8 *golden)
+{
+    S9xAPUSaveState(golden);
+    SNES::smp.ram_dirty = 0;
+}
+
+void S9xAPURestoreGolden(uint8 *golden)
+{
+    uint32 dirty = SNES::smp.ram_dirty | 1;
+
+    // the block starts with APU RAM, which is put back below a page at a time
+    LoadState(golden, false);
+
+    for (int page = 0; page < 16; page++)
+    {
+        if (dirty & (1u << page))
+            memcpy(SNES::smp.apuram + (page << 12), golden + (page << 12), 0x1000);
+    }
+
+    SNES::smp.ram_dirty = 0;
+    SNES::smp.block_flush();
+}
+
 static void to_var_from_buf(uint8 **buf, void *var, size_t size)
 {
     memcpy(var, *buf, size);
@@ -374,6 +442,7 @@ void S9xAPULoadBlarggState(uint8 *oldblock)
     SNES::SPC_State_Copier copier(&ptr, to_var_from_buf);
 
     copier.copy(SNES::smp.apuram, 0x10000); // RAM
+    SNES::smp.ram_dirty = ~0u;
 
     uint8 regs_in[0x10];
     uint8 regs[0x10];
@@ -461,6 +530,9 @@ void S9xAPULoadBlarggState(uint8 *oldblock)
 
     // default to 0 - we are on an opcode boundary, shouldn't matter
     SNES::smp.rd = SNES::smp.wr = SNES::smp.dp = SNES::smp.sp = SNES::smp.ya = SNES::smp.bit = 0;
+    SNES::smp.timer_clock = SNES::smp.clock;
+    SNES::smp.idle.valid = false;
+    SNES::smp.block_flush();
 
     spc::reference_time = SNES::get_le32(ptr);
     ptr += sizeof(int32);
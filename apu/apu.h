@@ -27,6 +27,11 @@ void S9xAPUTimingSetSpeedup (int);
 void S9xAPULoadState (uint8 *);
 void S9xAPULoadBlarggState(uint8 *oldblock);
 void S9xAPUSaveState (uint8 *);
+// For S9xRestoreGoldenState: S9xAPUSaveGolden saves a state block like S9xAPUSaveState,
+// S9xAPURestoreGolden loads it back but copies only the APU RAM pages written since
+// either was called
+void S9xAPUSaveGolden (uint8 *);
+void S9xAPURestoreGolden (uint8 *);
 void S9xDumpSPCSnapshot (void);
 bool8 S9xSPCDump (const char *);
 
@@ -40,6 +45,8 @@ void S9xSetSoundMute (bool8);
 void S9xLandSamples (void);
 void S9xClearSamples (void);
 bool8 S9xMixSamples (uint8 *, int);
+int S9xPeekSamples (int16 **);
+void S9xReleaseSamples (int);
 void S9xSetSamplesAvailableCallback (apu_callback, void *);
 void S9xUpdateDynamicRate (int empty = 1, int buffer_size = 2);
 
@@ -28,6 +28,11 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 	#error "Requires that int type have at least 32 bits"
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define SPC_DSP_SSE2 1
+#endif
+
 // TODO: add to blargg_endian.h
 #define GET_LE16SA( addr )      ((BOOST::int16_t) GET_LE16( addr ))
 #define GET_LE16A( addr )       GET_LE16( addr )
@@ -820,6 +825,7 @@ inline VOICE_CLOCK( V3c )
 	}
 
 	// Gaussian interpolation
+	if ( v->env )
 	{
 		int output = interpolate( v );
 
@@ -831,6 +837,12 @@ inline VOICE_CLOCK( V3c )
 		m.t_output = (output * v->env) >> 11 & ~1;
 		v->t_envx_out = (uint8_t) (v->env >> 4);
 	}
+	else
+	{
+		// A silent voice outputs zero whatever it would have interpolated
+		m.t_output = 0;
+		v->t_envx_out = 0;
+	}
 
 	// Immediate silence due to end of sample or soft reset
 	if ( REG(flg) & 0x80 || (m.t_brr_header & 3) == 1 )
@@ -860,6 +872,10 @@ inline VOICE_CLOCK( V3c )
 
 inline void SPC_DSP::voice_output( voice_t const* v, int ch )
 {
+	// The echo total still has to be kept, it ends up in APU RAM
+	if ( skip_output && !(m.t_eon & v->vbit) )
+		return;
+
 	// Apply left/right volume
 	int amp = (m.t_output * (int8_t) VREG(v->regs,voll + ch)) >> 7;
 	amp *= ((stereo_switch & (1 << (v->voice_number + ch * voice_count))) ? 1 : 0);
@@ -1033,6 +1049,67 @@ ECHO_CLOCK( 25 )
 	m.t_echo_in [0] = l & ~1;
 	m.t_echo_in [1] = r & ~1;
 }
+// Phases 22 to 25 at once, for when run() covers all four of them. Registers
+// and RAM can't change in between, so this gives the same result as reading
+// the right channel and adding taps clock by clock.
+inline void SPC_DSP::echo_fir()
+{
+	if ( ++m.echo_hist_pos >= &m.echo_hist [echo_hist_size] )
+		m.echo_hist_pos = m.echo_hist;
+
+	m.t_echo_ptr = (m.t_esa * 0x100 + m.echo_offset) & 0xFFFF;
+	echo_read( 0 );
+	echo_read( 1 );
+
+	int l, r;
+	int l6, r6, l7, r7;
+
+#if SPC_DSP_SSE2
+	// History entries are 15-bit, so with a zero in the upper half of each
+	// coefficient pair pmaddwd gives the exact 32-bit product per channel.
+	// Taps are shifted individually before summing, as on the real DSP.
+	__m128i const* hist = (__m128i const*) &ECHO_FIR( 1 );
+	__m128i sum, t67;
+
+	#define FIR_PAIR( i ) \
+		_mm_srai_epi32( _mm_madd_epi16( _mm_loadu_si128( hist + i / 2 ), \
+			_mm_set_epi16( 0, (int8_t) REG(fir + (i + 1) * 0x10), 0, (int8_t) REG(fir + (i + 1) * 0x10), \
+			               0, (int8_t) REG(fir +  i      * 0x10), 0, (int8_t) REG(fir +  i      * 0x10) ) ), 6 )
+
+	sum = _mm_add_epi32( _mm_add_epi32( FIR_PAIR( 0 ), FIR_PAIR( 2 ) ), FIR_PAIR( 4 ) );
+	sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	t67 = FIR_PAIR( 6 );
+
+	#undef FIR_PAIR
+
+	l  = _mm_cvtsi128_si32( sum );
+	r  = _mm_cvtsi128_si32( _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+	l6 = _mm_cvtsi128_si32( t67 );
+	r6 = _mm_cvtsi128_si32( _mm_shuffle_epi32( t67, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+	l7 = _mm_cvtsi128_si32( _mm_shuffle_epi32( t67, _MM_SHUFFLE( 2, 2, 2, 2 ) ) );
+	r7 = _mm_cvtsi128_si32( _mm_shuffle_epi32( t67, _MM_SHUFFLE( 3, 3, 3, 3 ) ) );
+#else
+	l = CALC_FIR( 0, 0 ) + CALC_FIR( 1, 0 ) + CALC_FIR( 2, 0 ) + CALC_FIR( 3, 0 ) + CALC_FIR( 4, 0 ) + CALC_FIR( 5, 0 );
+	r = CALC_FIR( 0, 1 ) + CALC_FIR( 1, 1 ) + CALC_FIR( 2, 1 ) + CALC_FIR( 3, 1 ) + CALC_FIR( 4, 1 ) + CALC_FIR( 5, 1 );
+	l6 = CALC_FIR( 6, 0 );
+	r6 = CALC_FIR( 6, 1 );
+	l7 = CALC_FIR( 7, 0 );
+	r7 = CALC_FIR( 7, 1 );
+#endif
+
+	// Same wrap and clamp as echo_25
+	l = (int16_t) (l + l6);
+	r = (int16_t) (r + r6);
+
+	l += (int16_t) l7;
+	r += (int16_t) r7;
+
+	CLAMP16( l );
+	CLAMP16( r );
+
+	m.t_echo_in [0] = l & ~1;
+	m.t_echo_in [1] = r & ~1;
+}
 inline int SPC_DSP::echo_output( int ch )
 {
 	int out = (int16_t) ((m.t_main_out [ch] * (int8_t) REG(mvoll + ch * 0x10)) >> 7) +
@@ -1044,7 +1121,8 @@ ECHO_CLOCK( 26 )
 {
 	// Left output volumes
 	// (save sample for next clock so we can output both together)
-	m.t_main_out [0] = echo_output( 0 );
+	if ( !skip_output )
+		m.t_main_out [0] = echo_output( 0 );
 
 	// Echo feedback
 	int l = m.t_echo_out [0] + (int16_t) ((m.t_echo_in [0] * (int8_t) REG(efb)) >> 7);
@@ -1058,6 +1136,17 @@ ECHO_CLOCK( 26 )
 }
 ECHO_CLOCK( 27 )
 {
+	if ( skip_output )
+	{
+		m.t_main_out [0] = 0;
+		m.t_main_out [1] = 0;
+
+		// MSU-1 playback still has to advance with the DSP
+		if ( Settings.MSU1 )
+			S9xMSU1Generate( 2 );
+		return;
+	}
+
 	// Output
 	int l = m.t_main_out [0];
 	int r = echo_output( 1 );
@@ -1088,8 +1177,14 @@ ECHO_CLOCK( 28 )
 inline void SPC_DSP::echo_write( int ch )
 {
 	if ( !(m.t_echo_enabled & 0x20) )
+	{
 		SET_LE16A( ECHO_PTR( ch ), m.t_echo_out [ch] );
 
+		// The echo buffer may overwrite decoded SPC700 code
+		if ( !Settings.SeparateEchoBuffer )
+			smp.block_write( m.t_echo_ptr + ch * 2 );
+	}
+
 	m.t_echo_out [ch] = 0;
 }
 ECHO_CLOCK( 29 )
@@ -1152,10 +1247,10 @@ PHASE(18)                                     V(V8_V5_V2,5)\
 PHASE(19)                                     V(V9_V6_V3,5)\
 PHASE(20)         V(V1,1)                            V(V7,6)V(V4,7)\
 PHASE(21)                                            V(V8,6)V(V5,7)  V(V2,0)  /* t_brr_next_addr order dependency */\
-PHASE(22)  V(V3a,0)                                  V(V9,6)V(V6,7)  echo_22();\
-PHASE(23)                                                   V(V7,7)  echo_23();\
-PHASE(24)                                                   V(V8,7)  echo_24();\
-PHASE(25)  V(V3b,0)                                         V(V9,7)  echo_25();\
+PHASE(22)  V(V3a,0)                                  V(V9,6)V(V6,7)  ECHO_FIR_22();\
+PHASE(23)                                                   V(V7,7)  if ( !fir_done ) echo_23();\
+PHASE(24)                                                   V(V8,7)  if ( !fir_done ) echo_24();\
+PHASE(25)  V(V3b,0)                                         V(V9,7)  if ( !fir_done ) echo_25();\
 PHASE(26)                                                            echo_26();\
 PHASE(27) misc_27();                                                 echo_27();\
 PHASE(28) misc_28();                                                 echo_28();\
@@ -1169,8 +1264,17 @@ void SPC_DSP::run( int clocks_remain )
 {
 	require( clocks_remain > 0 );
 
+	// Nothing is listening, so only emulate what the SPC700 can observe
+	skip_output = Settings.FastDSP && Settings.Mute;
+
 	int const phase = m.phase;
 	m.phase = (phase + clocks_remain) & 31;
+
+	// Set when this call runs all of phases 22 to 25, see echo_fir
+	bool fir_done = false;
+	#define ECHO_FIR_22() \
+		if ( (fir_done = clocks_remain >= 4) ) echo_fir(); else echo_22();
+
 	switch ( phase )
 	{
 	loop:
@@ -1182,6 +1286,8 @@ void SPC_DSP::run( int clocks_remain )
 		if ( --clocks_remain )
 			goto loop;
 	}
+
+	#undef ECHO_FIR_22
 }
 
 #endif
@@ -1199,6 +1305,7 @@ void SPC_DSP::init( void* ram_64k )
 
 	stereo_switch = 0xffff;
 	take_spc_snapshot = 0;
+	skip_output = false;
 	spc_snapshot_callback = 0;
 
 	#ifndef NDEBUG
@@ -71,6 +71,7 @@ public:
 
 	int     stereo_switch;
 	int     take_spc_snapshot;
+	bool    skip_output; // Settings.FastDSP while muted, latched by run()
 	void    (*spc_snapshot_callback) (void);
 
 	void    set_spc_snapshot_callback( void (*callback) (void) );
@@ -242,6 +243,7 @@ private:
 	void echo_read( int ch );
 	int  echo_output( int ch );
 	void echo_write( int ch );
+	void echo_fir();
 	void echo_22();
 	void echo_23();
 	void echo_24();
@@ -0,0 +1,102 @@
+//Straight-line runs of code in plain RAM are decoded once and then executed
+//without the per-opcode trace check and without the MMIO/IPL range checks on
+//every opcode and operand fetch. A run starts at any PC in $0200-$ffbf, ends
+//after the first instruction that can change PC (or after 32 instructions)
+//and never reaches $ffc0, so every byte it fetches is apuram whether or not
+//the IPL ROM is mapped. The zero page and stack are never decoded; they hold
+//MMIO and are written far too often to be worth tracking.
+//
+//Only the instruction count of each run is cached. Opcodes and operands are
+//still fetched from apuram as they execute, so what must stay valid is the
+//boundary between runs: a write to a page holding decoded code, by the SMP or
+//by the DSP echo buffer, drops every run that may overlap it and stops the
+//run in progress after the current instruction.
+
+//instruction length, | 0x80 for instructions that can change PC
+const uint8 SMP::block_op_info[256] = {
+  0x01, 0x81, 0x02, 0x83, 0x02, 0x03, 0x01, 0x02, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x03, 0x81,
+  0x82, 0x81, 0x02, 0x83, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x02, 0x02, 0x01, 0x01, 0x03, 0x83,
+  0x01, 0x81, 0x02, 0x83, 0x02, 0x03, 0x01, 0x02, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x83, 0x82,
+  0x82, 0x81, 0x02, 0x83, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x02, 0x02, 0x01, 0x01, 0x02, 0x83,
+  0x01, 0x81, 0x02, 0x83, 0x02, 0x03, 0x01, 0x02, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x03, 0x82,
+  0x82, 0x81, 0x02, 0x83, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x02, 0x02, 0x01, 0x01, 0x03, 0x83,
+  0x01, 0x81, 0x02, 0x83, 0x02, 0x03, 0x01, 0x02, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x83, 0x81,
+  0x82, 0x81, 0x02, 0x83, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x02, 0x02, 0x01, 0x01, 0x02, 0x81,
+  0x01, 0x81, 0x02, 0x83, 0x02, 0x03, 0x01, 0x02, 0x02, 0x03, 0x03, 0x02, 0x03, 0x02, 0x01, 0x03,
+  0x82, 0x81, 0x02, 0x83, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x02, 0x02, 0x01, 0x01, 0x01, 0x01,
+  0x01, 0x81, 0x02, 0x83, 0x02, 0x03, 0x01, 0x02, 0x02, 0x03, 0x03, 0x02, 0x03, 0x02, 0x01, 0x01,
+  0x82, 0x81, 0x02, 0x83, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x02, 0x02, 0x01, 0x01, 0x01, 0x01,
+  0x01, 0x81, 0x02, 0x83, 0x02, 0x03, 0x01, 0x02, 0x02, 0x03, 0x03, 0x02, 0x03, 0x02, 0x01, 0x01,
+  0x82, 0x81, 0x02, 0x83, 0x02, 0x03, 0x03, 0x02, 0x02, 0x02, 0x02, 0x02, 0x01, 0x01, 0x83, 0x01,
+  0x01, 0x81, 0x02, 0x83, 0x02, 0x03, 0x01, 0x02, 0x02, 0x03, 0x03, 0x02, 0x03, 0x01, 0x01, 0x81,
+  0x82, 0x81, 0x02, 0x83, 0x02, 0x03, 0x03, 0x02, 0x02, 0x02, 0x03, 0x02, 0x01, 0x01, 0x82, 0x81,
+};
+
+void SMP::block_flush() {
+  //every decoded run starts in a marked page; state loads come through here
+  //often enough (run-ahead) that clearing all 64K each time shows up
+  for(unsigned page = 0; page < 256; page++) {
+    if(block_pages[page >> 5] & (1u << (page & 31))) memset(block_length + (page << 8), 0, 256);
+  }
+  memset(block_pages, 0, sizeof(block_pages));
+  block_remaining = 0;
+}
+
+void SMP::block_invalidate(unsigned page) {
+  //a run is at most 96 bytes long, so only runs starting in this page or the
+  //one before it can reach into it
+  memset(block_length + (page << 8), 0, 256);
+  if(page) memset(block_length + ((page - 1) << 8), 0, 256);
+  block_pages[page >> 5] &= ~(1u << (page & 31));
+  block_remaining = 0;
+}
+
+unsigned SMP::block_decode(uint16 addr) {
+  if(addr < 0x0200 || addr >= 0xffc0) return 0;
+
+  unsigned count = 0;
+  unsigned pc = addr;
+  while(count < 32) {
+    uint8 info = block_op_info[apuram[pc]];
+    if(pc + (info & 3) > 0xffc0) break;
+    pc += info & 3;
+    count++;
+    if(info & 0x80) break;
+  }
+  if(!count) return 0;
+
+  for(unsigned page = addr >> 8; page <= (pc - 1) >> 8; page++) {
+    block_pages[page >> 5] |= 1u << (page & 31);
+  }
+  block_length[addr] = count;
+  return count;
+}
+
+//runs up to count instructions from a decoded run, returns the address of the
+//last one started
+uint16 SMP::block_run(unsigned count) {
+  #undef op_readpc
+  #define op_readpc() (tick(), apuram[regs.pc++])
+
+  uint16 pc = regs.pc;
+  block_remaining = count;
+
+  do {
+    if(opcode_cycle == 0) {
+      if(!block_remaining) break;
+      block_remaining--;
+      pc = regs.pc;
+      opcode_number = op_readpc();
+    }
+
+    switch(opcode_number) {
+      #include "core/oppseudo_misc.cpp"
+      #include "core/oppseudo_mov.cpp"
+      #include "core/oppseudo_pc.cpp"
+      #include "core/oppseudo_read.cpp"
+      #include "core/oppseudo_rmw.cpp"
+    }
+  } while(clock < 0);
+
+  return pc;
+}
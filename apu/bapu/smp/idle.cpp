@@ -0,0 +1,46 @@
+//Sound drivers spend most of their time in tight loops polling $f4-$f7 or a
+//timer counter. The S-CPU is stopped while the SMP catches up, so the ports
+//cannot change during SMP::enter. An iteration that wrote nothing, did not
+//read the DSP, read zero from every timer counter it touched and came back to
+//the same registers will therefore repeat exactly until a timer it reads
+//increments or the catch-up window ends. Those iterations are skipped in one
+//step; the DSP and the timers still see every clock through dsp.clock and
+//sync_timers().
+
+void SMP::idle_check() {
+  uint8 p = regs.p;
+
+  if(idle.valid && idle.pc == regs.pc && idle.ya == regs.ya && idle.x == regs.x
+  && idle.sp == regs.sp && idle.p == p && idle.writes == write_count && !idle.unsafe
+  && !memcmp(idle.ports, cpu.registers, 4)) {
+    int32 period = clock - idle.clock;
+    int32 budget = -clock;
+
+    //stop before any timer the loop reads changes its counter
+    sync_timers();
+    if((idle.timers_read & 1) && timer0.zero_clocks() < budget) budget = timer0.zero_clocks();
+    if((idle.timers_read & 2) && timer1.zero_clocks() < budget) budget = timer1.zero_clocks();
+    if((idle.timers_read & 4) && timer2.zero_clocks() < budget) budget = timer2.zero_clocks();
+
+    if(period > 0 && budget >= period) {
+      unsigned clocks = budget / period * period;
+
+      clock += clocks;
+      dsp.clock += clocks;
+      idle_skipped += clocks;
+    }
+  }
+
+  //this visit is the reference for the next iteration
+  idle.valid = true;
+  idle.pc = regs.pc;
+  idle.ya = regs.ya;
+  idle.x = regs.x;
+  idle.sp = regs.sp;
+  idle.p = p;
+  memcpy(idle.ports, cpu.registers, 4);
+  idle.clock = clock;
+  idle.writes = write_count;
+  idle.timers_read = 0;
+  idle.unsafe = false;
+}
@@ -13,6 +13,7 @@ unsigned SMP::mmio_read(unsigned addr) {
     return status.dsp_addr;
 
   case 0xf3:
+    idle.unsafe = true;
     return dsp.read(status.dsp_addr & 0x7f);
 
   case 0xf4:
@@ -28,20 +29,29 @@ unsigned SMP::mmio_read(unsigned addr) {
     return status.ram00f9;
 
   case 0xfd: {
+    sync_timers();
     unsigned result = timer0.stage3_ticks & 15;
     timer0.stage3_ticks = 0;
+    idle.timers_read |= 1;
+    if(result) idle.unsafe = true;
     return result;
   }
 
   case 0xfe: {
+    sync_timers();
     unsigned result = timer1.stage3_ticks & 15;
     timer1.stage3_ticks = 0;
+    idle.timers_read |= 2;
+    if(result) idle.unsafe = true;
     return result;
   }
 
   case 0xff: {
+    sync_timers();
     unsigned result = timer2.stage3_ticks & 15;
     timer2.stage3_ticks = 0;
+    idle.timers_read |= 4;
+    if(result) idle.unsafe = true;
     return result;
   }
 
@@ -54,6 +64,7 @@ void SMP::mmio_write(unsigned addr, unsigned data) {
   switch(addr) {
 
   case 0xf1:
+    sync_timers();
     status.iplrom_enable = data & 0x80;
 
     if(data & 0x30) {
@@ -112,14 +123,17 @@ void SMP::mmio_write(unsigned addr, unsigned data) {
     break;
 
   case 0xfa:
+    sync_timers();
     timer0.target = data;
     break;
 
   case 0xfb:
+    sync_timers();
     timer1.target = data;
     break;
 
   case 0xfc:
+    sync_timers();
     timer2.target = data;
     break;
   }
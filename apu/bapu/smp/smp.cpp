@@ -20,9 +20,40 @@ SMP smp;
 #include "iplrom.cpp"
 #include "memory.cpp"
 #include "timing.cpp"
+#include "idle.cpp"
+#include "block.cpp"
 
 void SMP::enter() {
-  while(clock < 0) op_step();
+  timer_clock = clock;
+
+  bool skip_idle = Settings.SkipSMPIdleLoops;
+  //StepSMPOpcodes keeps the plain op_step() path as a reference for the decoded runs
+  bool use_blocks = !Settings.StepSMPOpcodes;
+#ifdef DEBUGGER
+  if(Settings.TraceSMP) skip_idle = use_blocks = false;
+#endif
+
+  //idle.clock is kept relative to the clock at the end of the previous call
+  idle.clock += clock;
+  while(clock < 0) {
+    uint16 pc = regs.pc;
+    bool whole = opcode_cycle == 0;
+    unsigned count = 0;
+    if(whole && use_blocks) {
+      count = block_length[pc];
+      if(!count) count = block_decode(pc);
+    }
+    //a decoded run only ends in a branch, so pc is the last instruction it ran
+    if(count) pc = block_run(count);
+    else op_step();
+    //only a branch of a few bytes backwards can close a poll loop; branches
+    //always complete in one step, unlike the split dp reads
+    if(skip_idle && whole && opcode_cycle == 0 && (uint16)(pc - regs.pc) < 64) idle_check();
+  }
+  idle.clock -= clock;
+
+  //leave the timers current for save states and the CPU side
+  sync_timers();
 }
 
 void SMP::power() {
@@ -37,6 +68,7 @@ void SMP::power() {
 
 void SMP::reset() {
   for(unsigned n = 0x0000; n <= 0xffff; n++) apuram[n] = 0x00;
+  ram_dirty = ~0u;
 
   opcode_number = 0;
   opcode_cycle = 0;
@@ -63,14 +95,28 @@ void SMP::reset() {
   timer0.stage1_ticks = timer1.stage1_ticks = timer2.stage1_ticks = 0;
   timer0.stage2_ticks = timer1.stage2_ticks = timer2.stage2_ticks = 0;
   timer0.stage3_ticks = timer1.stage3_ticks = timer2.stage3_ticks = 0;
+  timer_clock = clock;
+
+  idle.valid = false;
+  write_count = 0;
+  idle_skipped = 0;
+  block_flush();
 }
 
 SMP::SMP() {
   apuram = new uint8[64 * 1024];
+  block_length = new uint8[64 * 1024]();
+  memset(block_pages, 0, sizeof(block_pages));
+  block_remaining = 0;
+  timer_clock = 0;
+  idle.valid = false;
+  write_count = 0;
+  idle_skipped = 0;
 }
 
 SMP::~SMP() {
 	delete[] apuram;
+	delete[] block_length;
 }
 
 }
@@ -13,7 +13,7 @@ public:
   void power();
   void reset();
 
-  void load_state(uint8 **);
+  void load_state(uint8 **, bool ram = true);
   void save_state(uint8 **);
   void save_spc (uint8 *);
   SMP();
@@ -79,13 +79,55 @@ public:
     uint8 stage2_ticks;
     uint8 stage3_ticks;
 
-    inline void tick();
     inline void tick(unsigned clocks);
+    inline int zero_clocks() const;
   };
 
   Timer<128> timer0;
   Timer<128> timer1;
   Timer< 16> timer2;
+  int32 timer_clock;
+  inline void sync_timers();
+
+  //poll loop detection, see idle.cpp
+  struct IdleLoop {
+    bool valid;
+    uint16 pc;
+    uint16 ya;
+    uint8 x, sp, p;
+    uint8 ports[4];
+    int32 clock;
+    unsigned writes;
+    unsigned timers_read;
+    bool unsafe;
+  } idle;
+  unsigned write_count;
+  unsigned idle_skipped;
+
+  void idle_check();
+
+  //decoded runs of straight-line code, see block.cpp
+  static const uint8 block_op_info[256];
+  uint8 *block_length;
+  uint32 block_pages[8];
+  unsigned block_remaining;
+
+  void block_flush();
+  void block_invalidate(unsigned page);
+  unsigned block_decode(uint16 addr);
+  uint16 block_run(unsigned count);
+
+  //4KB pages of apuram written since S9xAPURestoreRAM last ran; the first
+  //page, which holds the stack and the ports, is always restored, so stack
+  //pushes and port writes don't need to mark anything
+  uint32 ram_dirty;
+
+  //also called by the DSP for echo buffer writes
+  inline void block_write(uint16 addr) {
+    unsigned page = addr >> 8;
+    ram_dirty |= 1u << (addr >> 12);
+    if(block_pages[page >> 5] & (1u << (page & 31))) block_invalidate(page);
+  }
 
   inline void tick();
   inline void tick(unsigned clocks);
@@ -132,9 +132,13 @@ void SMP::save_state(uint8 **block) {
   *block = ptr;
 }
 
-void SMP::load_state(uint8 **block) {
+//ram is false when the caller puts apuram back itself (S9xAPURestoreRAM)
+void SMP::load_state(uint8 **block, bool ram) {
   uint8 *ptr = *block;
-  memcpy(apuram, ptr, 64 * 1024);
+  if(ram) {
+    memcpy(apuram, ptr, 64 * 1024);
+    ram_dirty = ~0u;
+  }
   ptr += 64 * 1024;
 
 #undef INT32
@@ -191,6 +195,10 @@ void SMP::load_state(uint8 **block) {
   INT32(ya);
   INT32(bit);
 
+  timer_clock = clock;
+  idle.valid = false;
+  block_flush();
+
   *block = ptr;
 }
 
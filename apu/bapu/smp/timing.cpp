@@ -1,26 +1,42 @@
+//timers are not ticked per bus cycle; SMP::sync_timers() catches them up
+//before their state is observed or changed, any number of clocks at once
 template<unsigned cycle_frequency>
-void SMP::Timer<cycle_frequency>::tick() {
-  if(++stage1_ticks < cycle_frequency) return;
-
-  stage1_ticks = 0;
+void SMP::Timer<cycle_frequency>::tick(unsigned clocks) {
+  unsigned total = stage1_ticks + clocks;
+  stage1_ticks = total % cycle_frequency;
   if(enable == false) return;
 
-  if(++stage2_ticks != target) return;
+  unsigned steps = total / cycle_frequency;
+  unsigned first = (uint8)(target - stage2_ticks);
+  if(first == 0) first = 256;
+  if(steps < first) {
+    stage2_ticks += steps;
+    return;
+  }
 
-  stage2_ticks = 0;
-  stage3_ticks = (stage3_ticks + 1) & 15;
+  steps -= first;
+  unsigned period = target ? target : 256;
+  stage2_ticks = steps % period;
+  stage3_ticks = (stage3_ticks + 1 + steps / period) & 15;
 }
 
+//clocks that can pass while a read of the counter still returns zero
 template<unsigned cycle_frequency>
-void SMP::Timer<cycle_frequency>::tick(unsigned clocks) {
-  stage1_ticks += clocks;
-  if(stage1_ticks < cycle_frequency) return;
+int SMP::Timer<cycle_frequency>::zero_clocks() const {
+  if(stage3_ticks) return 0;
+  if(enable == false) return 0x7fffffff;
 
-  stage1_ticks -= cycle_frequency;
-  if(enable == false) return;
+  int steps = (uint8)(target - stage2_ticks);
+  if(steps == 0) steps = 256;
+  return steps * (int)cycle_frequency - stage1_ticks - 1;
+}
 
-  if(++stage2_ticks != target) return;
+void SMP::sync_timers() {
+  int32 clocks = clock - timer_clock;
+  if(clocks <= 0) return;
 
-  stage2_ticks = 0;
-  stage3_ticks = (stage3_ticks + 1) & 15;
+  timer0.tick(clocks);
+  timer1.tick(clocks);
+  timer2.tick(clocks);
+  timer_clock = clock;
 }
@@ -137,10 +137,25 @@ class Resampler
         {
             buffer[end] = l;
             buffer[end + 1] = r;
-            end = (end + 2) % buffer_size;
+            end = (end + 2 == buffer_size) ? 0 : end + 2;
         }
     }
 
+    // Samples that can be read in place, up to the end of the buffer
+    inline int16_t *peek(int &num_samples) const
+    {
+        num_samples = (end >= start) ? end - start : buffer_size - start;
+        return buffer + start;
+    }
+
+    // Moves an empty buffer back to its beginning so the next samples are
+    // contiguous. Only safe when the producer isn't running on another thread.
+    inline void rewind(void)
+    {
+        if (start == end)
+            start = end = 0;
+    }
+
     inline bool push(int16_t *src, int num_samples)
     {
         if (space_empty() < num_samples)
@@ -13,6 +13,16 @@
 #include "memmap.h"
 #include "display.h"
 #include <math.h>
+#include <fstream>
+#include <algorithm>
+
+#if !defined(__WIN32__) && !defined(__LIBRETRO__)
+#define BSX_ARCHIVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 //#define BSX_DEBUG
 
@@ -76,6 +86,27 @@ static bool8	FlashMode;
 static uint32	FlashSize;
 static uint8	*MapROM, *FlashROM;
 
+struct SBSXArchiveEntry
+{
+	uint32	key;		// channel << 8 | count
+	uint32	offset;
+	uint32	size;
+};
+
+// The broadcast archive is mapped once and the streams point into it, so a
+// channel switch is a lookup in the index instead of a file open.
+static struct
+{
+	const uint8						*data;
+	size_t							size;
+	bool							mapped;
+	std::vector<uint8>				buffer;
+	std::vector<SBSXArchiveEntry>	entries;
+}	BSXArchive;
+
+// Without an archive, each BSXHHHH-D.bin file is read whole when a stream switches to it
+static std::vector<uint8>	LooseStream[2];
+
 static void BSX_Map_SNES (void);
 static void BSX_Map_LoROM (void);
 static void BSX_Map_HiROM (void);
@@ -87,6 +118,8 @@ static void BSX_Map_BIOS (void);
 static void BSX_Map_RAM (void);
 static void BSX_Map (void);
 static bool8 BSX_LoadBIOS (void);
+static bool8 BSX_OpenArchive (const std::string &);
+static void BSX_CloseArchive (void);
 static void map_psram_mirror_sub (uint32);
 static int is_bsx (unsigned char *);
 
@@ -515,6 +548,12 @@ static void BSX_Map (void)
 	BSX.dirty2 = FALSE;
 
 	Memory.map_WriteProtectROM();
+
+	S9xCoverageRefresh();
+
+#ifdef DEBUGGER
+	S9xRefreshWatchpoints();
+#endif
 }
 
 static uint8 BSX_Get_Bypass_FlashIO (uint32 offset)
@@ -733,25 +772,165 @@ void S9xSetBSX (uint8 byte, uint32 address)
 	}
 }
 
-void S9xBSXSetStream1 (uint8 count)
+static uint32 BSX_GetLE32 (const uint8 *p)
+{
+	return (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32) p[3] << 24));
+}
+
+static bool BSX_EntryLess (const SBSXArchiveEntry &a, const SBSXArchiveEntry &b)
+{
+	return (a.key < b.key);
+}
+
+static bool8 BSX_OpenArchive (const std::string &path)
+{
+	BSX_CloseArchive();
+
+#ifdef BSX_ARCHIVE_MMAP
+	int	fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return (FALSE);
+
+	struct stat	st;
+	if (fstat(fd, &st) == 0 && st.st_size >= BSX_ARCHIVE_HEADER_SIZE)
+	{
+		void	*p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED)
+		{
+			BSXArchive.data   = (const uint8 *) p;
+			BSXArchive.size   = st.st_size;
+			BSXArchive.mapped = true;
+		}
+	}
+
+	close(fd);
+#else
+	std::ifstream	file(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file.good())
+		return (FALSE);
+
+	file.seekg(0, file.end);
+	long	size = file.tellg();
+	file.seekg(0, file.beg);
+
+	if (size >= BSX_ARCHIVE_HEADER_SIZE)
+	{
+		BSXArchive.buffer.resize(size);
+		if (file.read((char *) &BSXArchive.buffer[0], size))
+		{
+			BSXArchive.data = &BSXArchive.buffer[0];
+			BSXArchive.size = size;
+		}
+	}
+#endif
+
+	if (!BSXArchive.data)
+		return (FALSE);
+
+	const uint8	*header = BSXArchive.data;
+	uint32		count   = BSX_GetLE32(header + 12);
+
+	if (memcmp(header, BSX_ARCHIVE_MAGIC, 8) || BSX_GetLE32(header + 8) != BSX_ARCHIVE_VERSION ||
+		count > (BSXArchive.size - BSX_ARCHIVE_HEADER_SIZE) / BSX_ARCHIVE_ENTRY_SIZE)
+	{
+		BSX_CloseArchive();
+		return (FALSE);
+	}
+
+	BSXArchive.entries.resize(count);
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		const uint8			*p = header + BSX_ARCHIVE_HEADER_SIZE + i * BSX_ARCHIVE_ENTRY_SIZE;
+		SBSXArchiveEntry	&entry = BSXArchive.entries[i];
+
+		entry.key    = (p[0] | (p[1] << 8)) << 8 | p[2];
+		entry.offset = BSX_GetLE32(p + 4);
+		entry.size   = BSX_GetLE32(p + 8);
+
+		if (entry.offset > BSXArchive.size || entry.size > BSXArchive.size - entry.offset)
+		{
+			BSX_CloseArchive();
+			return (FALSE);
+		}
+	}
+
+	std::sort(BSXArchive.entries.begin(), BSXArchive.entries.end(), BSX_EntryLess);
+
+	return (TRUE);
+}
+
+static void BSX_CloseArchive (void)
+{
+	// the streams may point into the archive
+	BSX.sat_stream1_loaded = BSX.sat_stream2_loaded = FALSE;
+	BSX.sat_stream1_data = BSX.sat_stream2_data = NULL;
+	BSX.sat_stream1_size = BSX.sat_stream2_size = 0;
+
+#ifdef BSX_ARCHIVE_MMAP
+	if (BSXArchive.mapped)
+		munmap((void *) BSXArchive.data, BSXArchive.size);
+#endif
+
+	BSXArchive.data   = NULL;
+	BSXArchive.size   = 0;
+	BSXArchive.mapped = false;
+	BSXArchive.buffer.clear();
+	BSXArchive.entries.clear();
+}
+
+static bool8 BSX_OpenStream (int stream, uint16 channel, uint8 count, const uint8 *&data, uint32 &size)
 {
-	if (BSX.sat_stream1.is_open())
-		BSX.sat_stream1.close(); //If Stream already opened for one file: Close it.
+	if (BSXArchive.data)
+	{
+		SBSXArchiveEntry	key = { (uint32) (channel << 8 | count), 0, 0 };
+
+		std::vector<SBSXArchiveEntry>::const_iterator	entry =
+			std::lower_bound(BSXArchive.entries.begin(), BSXArchive.entries.end(), key, BSX_EntryLess);
+
+		if (entry == BSXArchive.entries.end() || entry->key != key.key)
+			return (FALSE);
+
+		data = BSXArchive.data + entry->offset;
+		size = entry->size;
+
+		return (TRUE);
+	}
 
 	std::string path = S9xGetDirectory(SAT_DIR) + SLASH_STR;
 
 	char name[PATH_MAX];
-	snprintf(name, PATH_MAX, "BSX%04X-%d.bin", (BSX.PPU[0x2188 - BSXPPUBASE] | (BSX.PPU[0x2189 - BSXPPUBASE] * 256)), count); //BSXHHHH-DDD.bin
+	snprintf(name, PATH_MAX, "BSX%04X-%d.bin", channel, count); //BSXHHHH-DDD.bin
 	path += name;
 
-	BSX.sat_stream1.clear();
-	BSX.sat_stream1.open(path.c_str(), std::ios::in | std::ios::binary);
-	if (BSX.sat_stream1.good())
+	std::ifstream	file(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file.good())
+		return (FALSE);
+
+	file.seekg(0, file.end);
+	long	length = file.tellg();
+	file.seekg(0, file.beg);
+
+	std::vector<uint8>	&buffer = LooseStream[stream];
+
+	buffer.resize(length > 0 ? length : 0);
+	if (!buffer.empty())
+		file.read((char *) &buffer[0], buffer.size());
+
+	data = buffer.empty() ? NULL : &buffer[0];
+	size = (uint32) buffer.size();
+
+	return (TRUE);
+}
+
+void S9xBSXSetStream1 (uint8 count)
+{
+	uint16	channel = BSX.PPU[0x2188 - BSXPPUBASE] | (BSX.PPU[0x2189 - BSXPPUBASE] * 256);
+
+	if (BSX_OpenStream(0, channel, count, BSX.sat_stream1_data, BSX.sat_stream1_size))
 	{
-		BSX.sat_stream1.seekg(0, BSX.sat_stream1.end);
-		long str1size = BSX.sat_stream1.tellg();
-		BSX.sat_stream1.seekg(0, BSX.sat_stream1.beg);
-		float QueueSize = str1size / 22.;
+		BSX.sat_stream1_pos = 0;
+		float QueueSize = BSX.sat_stream1_size / 22.;
 		BSX.sat_stream1_queue = (uint16)(ceil(QueueSize));
 		BSX.PPU[0x218D - BSXPPUBASE] = 0;
 		BSX.sat_stream1_first = TRUE;
@@ -765,24 +944,12 @@ void S9xBSXSetStream1 (uint8 count)
 
 void S9xBSXSetStream2 (uint8 count)
 {
-	if (BSX.sat_stream2.is_open())
-		BSX.sat_stream2.close(); //If Stream already opened for one file: Close it.
-
-
-	std::string path = S9xGetDirectory(SAT_DIR) + SLASH_STR;
+	uint16	channel = BSX.PPU[0x218E - BSXPPUBASE] | (BSX.PPU[0x218F - BSXPPUBASE] * 256);
 
-	char name[PATH_MAX];
-	snprintf(name, PATH_MAX, "BSX%04X-%d.bin", (BSX.PPU[0x218E - BSXPPUBASE] | (BSX.PPU[0x218F - BSXPPUBASE] * 256)), count); //BSXHHHH-DDD.bin
-	path += name;
-
-	BSX.sat_stream2.clear();
-	BSX.sat_stream2.open(path.c_str(), std::ios::in | std::ios::binary);
-	if (BSX.sat_stream2.good())
+	if (BSX_OpenStream(1, channel, count, BSX.sat_stream2_data, BSX.sat_stream2_size))
 	{
-		BSX.sat_stream2.seekg(0, BSX.sat_stream2.end);
-		long str2size = BSX.sat_stream2.tellg();
-		BSX.sat_stream2.seekg(0, BSX.sat_stream2.beg);
-		float QueueSize = str2size / 22.;
+		BSX.sat_stream2_pos = 0;
+		float QueueSize = BSX.sat_stream2_size / 22.;
 		BSX.sat_stream2_queue = (uint16)(ceil(QueueSize));
 		BSX.PPU[0x2193 - BSXPPUBASE] = 0;
 		BSX.sat_stream2_first = TRUE;
@@ -937,10 +1104,10 @@ uint8 S9xGetBSXPPU (uint16 address)
 				}
 				else if (BSX.sat_stream1_loaded)
 				{
-					if (BSX.sat_stream1.eof())
-						BSX.PPU[0x218C - BSXPPUBASE] = 0xFF;
+					if (BSX.sat_stream1_pos < BSX.sat_stream1_size)
+						BSX.PPU[0x218C - BSXPPUBASE] = BSX.sat_stream1_data[BSX.sat_stream1_pos++];
 					else
-						BSX.PPU[0x218C - BSXPPUBASE] = BSX.sat_stream1.get();
+						BSX.PPU[0x218C - BSXPPUBASE] = 0xFF;
 				}
 				t = BSX.PPU[0x218C - BSXPPUBASE];
 			}
@@ -1054,10 +1221,10 @@ uint8 S9xGetBSXPPU (uint16 address)
 				}
 				else if (BSX.sat_stream2_loaded)
 				{
-					if (BSX.sat_stream2.eof())
-						BSX.PPU[0x2192 - BSXPPUBASE] = 0xFF;
+					if (BSX.sat_stream2_pos < BSX.sat_stream2_size)
+						BSX.PPU[0x2192 - BSXPPUBASE] = BSX.sat_stream2_data[BSX.sat_stream2_pos++];
 					else
-						BSX.PPU[0x2192 - BSXPPUBASE] = BSX.sat_stream2.get();
+						BSX.PPU[0x2192 - BSXPPUBASE] = 0xFF;
 				}
 				t = BSX.PPU[0x2192 - BSXPPUBASE];
 			}
@@ -1329,7 +1496,16 @@ void S9xInitBSX (void)
 #endif
 		*/
 		SNESGameFixes.SRAMInitialValue = 0x00;
+
+		BSX_OpenArchive(S9xGetDirectory(SAT_DIR) + SLASH_STR + BSX_ARCHIVE_NAME);
 	}
+	else
+		BSX_CloseArchive();
+}
+
+void S9xDeinitBSX (void)
+{
+	BSX_CloseArchive();
 }
 
 void S9xResetBSX (void)
@@ -1372,11 +1548,11 @@ void S9xResetBSX (void)
 	BSX.sat_stream1_first = BSX.sat_stream2_first = FALSE;
 	BSX.sat_stream1_count = BSX.sat_stream2_count = 0;
 
-    if (BSX.sat_stream1.is_open())
-        BSX.sat_stream1.close();
-
-    if (BSX.sat_stream2.is_open())
-        BSX.sat_stream2.close();
+	BSX.sat_stream1_data = BSX.sat_stream2_data = NULL;
+	BSX.sat_stream1_size = BSX.sat_stream2_size = 0;
+	BSX.sat_stream1_pos = BSX.sat_stream2_pos = 0;
+	LooseStream[0].clear();
+	LooseStream[1].clear();
 
     if (Settings.BS)
 	    BSX_Map();
@@ -7,7 +7,15 @@
 #ifndef _BSX_H_
 #define _BSX_H_
 
-#include <fstream>
+// Packed broadcast archive, built from the BSXHHHH-D.bin files by bsxpack.
+// Header: magic, uint32 version, uint32 entry count. Each entry is uint16
+// channel, uint8 count, uint8 reserved, uint32 offset and uint32 size, sorted
+// by channel and count. All values are little-endian.
+#define BSX_ARCHIVE_NAME		"BSX.pak"
+#define BSX_ARCHIVE_MAGIC		"S9XBSXPK"
+#define BSX_ARCHIVE_VERSION		1
+#define BSX_ARCHIVE_HEADER_SIZE	16
+#define BSX_ARCHIVE_ENTRY_SIZE	12
 
 struct SBSX
 {
@@ -32,8 +40,9 @@ struct SBSX
 	bool	flash_bsr;
 	bool	flash_cmd_done;
 
-	std::ifstream	sat_stream1;
-	std::ifstream	sat_stream2;
+	const uint8	*sat_stream1_data, *sat_stream2_data;
+	uint32	sat_stream1_size, sat_stream2_size;
+	uint32	sat_stream1_pos, sat_stream2_pos;
 
 	bool	sat_pf_latch1_enable, sat_dt_latch1_enable;
 	bool	sat_pf_latch2_enable, sat_dt_latch2_enable;
@@ -52,6 +61,7 @@ uint8 S9xGetBSXPPU (uint16);
 void S9xSetBSXPPU (uint8, uint16);
 uint8 * S9xGetBasePointerBSX (uint32);
 void S9xInitBSX (void);
+void S9xDeinitBSX (void);
 void S9xResetBSX (void);
 void S9xBSXPostLoadState (void);
 
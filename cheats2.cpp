@@ -88,6 +88,10 @@ static inline uint8 S9xGetByteFree(uint32 Address)
         byte = S9xGetBSX(Address);
         return (byte);
 
+    case CMemory::MAP_COVERAGE:
+        byte = *(Coverage.Map[block] + (Address & 0xffff));
+        return (byte);
+
     case CMemory::MAP_NONE:
     default:
         byte = OpenBus;
@@ -102,7 +106,9 @@ static inline void S9xSetByteFree(uint8 Byte, uint32 Address)
 
     if (SetAddress >= (uint8 *)CMemory::MAP_LAST)
     {
-        *(SetAddress + (Address & 0xffff)) = Byte;
+        SetAddress += Address & 0xffff;
+        *SetAddress = Byte;
+        S9xMarkDirtyPage(SetAddress);
         return;
     }
 
@@ -123,6 +129,7 @@ static inline void S9xSetByteFree(uint8 Byte, uint32 Address)
         if (Memory.SRAMMask)
         {
             *(Memory.SRAM + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Memory.SRAMMask)) = Byte;
+            S9xMarkDirtyPage(Memory.SRAM + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Memory.SRAMMask));
             CPU.SRAMModified = TRUE;
         }
 
@@ -132,6 +139,7 @@ static inline void S9xSetByteFree(uint8 Byte, uint32 Address)
         if (Multi.sramMaskB)
         {
             *(Multi.sramB + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Multi.sramMaskB)) = Byte;
+            S9xMarkDirtyPage(Multi.sramB + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Multi.sramMaskB));
             CPU.SRAMModified = TRUE;
         }
 
@@ -141,6 +149,7 @@ static inline void S9xSetByteFree(uint8 Byte, uint32 Address)
         if (Memory.SRAMMask)
         {
             *(Memory.SRAM + (((Address & 0x7fff) - 0x6000 + ((Address & 0x1f0000) >> 3)) & Memory.SRAMMask)) = Byte;
+            S9xMarkDirtyPage(Memory.SRAM + (((Address & 0x7fff) - 0x6000 + ((Address & 0x1f0000) >> 3)) & Memory.SRAMMask));
             CPU.SRAMModified = TRUE;
         }
         return;
@@ -178,6 +187,12 @@ static inline void S9xSetByteFree(uint8 Byte, uint32 Address)
         S9xSetBSX(Byte, Address);
         return;
 
+    case CMemory::MAP_COVERAGE:
+        SetAddress = Coverage.Map[block] + (Address & 0xffff);
+        *SetAddress = Byte;
+        S9xMarkDirtyPage(SetAddress);
+        return;
+
     case CMemory::MAP_NONE:
     default:
         return;
@@ -4,11 +4,11 @@
    For further information, consult the LICENSE file in the root directory.
 \*****************************************************************************/
 
-#include <map>
 #include <set>
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <assert.h>
 #include <ctype.h>
 
@@ -146,9 +146,34 @@ static struct
 	struct crosshair	crosshair;
 }	macsrifle;
 
+struct keymap_slot
+{
+	uint32			id;		// InvalidControlID marks a free slot
+	s9xcommand_t	cmd;
+};
+
+// Events queued by S9xQueueButton/Axis/Pointer, see DrainInputQueue
+#define INPUT_QUEUE_SIZE	1024
+
+struct input_event
+{
+	uint32	id;
+	uint8	type;			// MAP_BUTTON, MAP_AXIS or MAP_POINTER
+	int16	data1, data2;
+};
+
+static struct
+{
+	input_event			events[INPUT_QUEUE_SIZE];
+	std::atomic<uint32>	head, tail;
+}	inputqueue;
+
+static vector<input_event>			deferredinput;	// commands taken off the queue at a latch, run at EOF
+
 static set<struct exemulti *>		exemultis;
 static set<uint32>					pollmap[NUMCTLS + 1];
-static map<uint32, s9xcommand_t>	keymap;
+static vector<keymap_slot>			keymap;			// open addressing, size is a power of two
+static uint32						keymap_count;
 static vector<s9xcommand_t *>		multis;
 static uint8						turbo_time;
 static uint8						pseudobuttons[256];
@@ -301,6 +326,10 @@ static const char * maptypename (int);
 static int32 ApplyMulti (s9xcommand_t *, int32, int16);
 static void do_polling (int);
 static void UpdatePolledMouse (int);
+static s9xcommand_t * keymap_find (uint32);
+static void keymap_set (uint32, const s9xcommand_t &);
+static void keymap_erase (uint32);
+static void DrainInputQueue (bool8);
 
 
 static string& operator += (string &s, int i)
@@ -410,6 +439,7 @@ void S9xUnmapAllControls (void)
 	S9xControlsReset();
 
 	keymap.clear();
+	keymap_count = 0;
 
 	for (int i = 0; i < (int) multis.size(); i++)
 		free(multis[i]);
@@ -1582,16 +1612,120 @@ const char ** S9xGetAllSnes9xCommands (void)
 	return (command_names);
 }
 
+// The mappings are looked up on every reported event, so they live in a flat
+// table with linear probing rather than in a tree. It only changes (and
+// allocates) when something is mapped.
+
+static uint32 keymap_hash (uint32 id)
+{
+	id *= 0x9E3779B1;
+	return (id ^ (id >> 15));
+}
+
+static int32 keymap_index (uint32 id)
+{
+	if (keymap.empty())
+		return (-1);
+
+	uint32	mask = keymap.size() - 1;
+
+	for (uint32 i = keymap_hash(id) & mask; ; i = (i + 1) & mask)
+	{
+		if (keymap[i].id == id)
+			return (i);
+
+		if (keymap[i].id == InvalidControlID)
+			return (-1);
+	}
+}
+
+static s9xcommand_t * keymap_find (uint32 id)
+{
+	int32	i = keymap_index(id);
+
+	return (i < 0 ? NULL : &keymap[i].cmd);
+}
+
+static void keymap_set (uint32 id, const s9xcommand_t &cmd)
+{
+	s9xcommand_t	*slot = keymap_find(id);
+
+	if (slot)
+	{
+		*slot = cmd;
+		return;
+	}
+
+	// keep the table at most half full
+	if ((keymap_count + 1) * 2 > keymap.size())
+	{
+		vector<keymap_slot>	old;
+		old.swap(keymap);
+
+		keymap_slot	free_slot;
+		memset(&free_slot, 0, sizeof(free_slot));
+		free_slot.id = InvalidControlID;
+
+		keymap.assign(old.empty() ? 64 : old.size() * 2, free_slot);
+		keymap_count = 0;
+
+		for (size_t i = 0; i < old.size(); i++)
+		{
+			if (old[i].id != InvalidControlID)
+				keymap_set(old[i].id, old[i].cmd);
+		}
+	}
+
+	uint32	mask = keymap.size() - 1;
+	uint32	i = keymap_hash(id) & mask;
+
+	while (keymap[i].id != InvalidControlID)
+		i = (i + 1) & mask;
+
+	keymap[i].id  = id;
+	keymap[i].cmd = cmd;
+	keymap_count++;
+}
+
+static void keymap_erase (uint32 id)
+{
+	int32	found = keymap_index(id);
+
+	if (found < 0)
+		return;
+
+	uint32	mask = keymap.size() - 1;
+	uint32	i = found;
+
+	// shift later entries of the probe sequence back so no tombstones are needed
+	for (uint32 j = (i + 1) & mask; keymap[j].id != InvalidControlID; j = (j + 1) & mask)
+	{
+		uint32	home = keymap_hash(keymap[j].id) & mask;
+
+		// an entry can move into the hole only if its home slot isn't cyclically in (i, j]
+		if (((j - home) & mask) >= ((j - i) & mask))
+		{
+			keymap[i] = keymap[j];
+			i = j;
+		}
+	}
+
+	keymap[i].id = InvalidControlID;
+	keymap_count--;
+}
+
 s9xcommand_t S9xGetMapping (uint32 id)
 {
-	if (keymap.count(id) == 0)
+	s9xcommand_t	*cmd = keymap_find(id);
+
+	if (!cmd)
 	{
 		s9xcommand_t	cmd;
 		cmd.type = S9xNoMapping;
 		return (cmd);
 	}
 	else
-		return (keymap[id]);
+		return (*cmd);
 }
 
 static const char * maptypename (int t)
@@ -1621,7 +1755,7 @@ void S9xUnmapID (uint32 id)
 	if (id >= PseudoPointerBase)
 		pseudopointer[id - PseudoPointerBase].mapped = false;
 
-	keymap.erase(id);
+	keymap_erase(id);
 }
 
 bool S9xMapButton (uint32 id, s9xcommand_t mapping, bool poll)
@@ -1698,7 +1832,7 @@ bool S9xMapButton (uint32 id, s9xcommand_t mapping, bool poll)
 
 	S9xUnmapID(id);
 
-	keymap[id] = mapping;
+	keymap_set(id, mapping);
 
 	if (t >= 0)
 		pollmap[t].insert(id);
@@ -1708,25 +1842,27 @@ bool S9xMapButton (uint32 id, s9xcommand_t mapping, bool poll)
 
 void S9xReportButton (uint32 id, bool pressed)
 {
-	if (keymap.count(id) == 0)
+	s9xcommand_t	*cmd = keymap_find(id);
+
+	if (!cmd)
 		return;
 
-	if (keymap[id].type == S9xNoMapping)
+	if (cmd->type == S9xNoMapping)
 		return;
 
-	if (maptype(keymap[id].type) != MAP_BUTTON)
+	if (maptype(cmd->type) != MAP_BUTTON)
 	{
-		fprintf(stderr, "ERROR: S9xReportButton called on %s ID 0x%08x\n", maptypename(maptype(keymap[id].type)), id);
+		fprintf(stderr, "ERROR: S9xReportButton called on %s ID 0x%08x\n", maptypename(maptype(cmd->type)), id);
 		return;
 	}
 
-	if (keymap[id].type == S9xButtonCommand)	// skips the "already-pressed check" unless it's a command, as a hack to work around the following problem:
-		if (keymap[id].button_norpt == pressed)	// FIXME: this makes the controls "stick" after loading a savestate while recording a movie and holding any button
+	if (cmd->type == S9xButtonCommand)	// skips the "already-pressed check" unless it's a command, as a hack to work around the following problem:
+		if (cmd->button_norpt == pressed)	// FIXME: this makes the controls "stick" after loading a savestate while recording a movie and holding any button
 			return;
 
-	keymap[id].button_norpt = pressed;
+	cmd->button_norpt = pressed;
 
-	S9xApplyCommand(keymap[id], pressed, 0);
+	S9xApplyCommand(*cmd, pressed, 0);
 }
 
 bool S9xMapPointer (uint32 id, s9xcommand_t mapping, bool poll)
@@ -1829,7 +1965,7 @@ bool S9xMapPointer (uint32 id, s9xcommand_t mapping, bool poll)
 	if (id >= PseudoPointerBase)
 		pseudopointer[id - PseudoPointerBase].mapped = true;
 
-	keymap[id] = mapping;
+	keymap_set(id, mapping);
 
 	if (mapping.pointer.aim_mouse0    )	mouse[0].ID     = id;
 	if (mapping.pointer.aim_mouse1    )	mouse[1].ID     = id;
@@ -1843,19 +1979,21 @@ bool S9xMapPointer (uint32 id, s9xcommand_t mapping, bool poll)
 
 void S9xReportPointer (uint32 id, int16 x, int16 y)
 {
-	if (keymap.count(id) == 0)
+	s9xcommand_t	*cmd = keymap_find(id);
+
+	if (!cmd)
 		return;
 
-	if (keymap[id].type == S9xNoMapping)
+	if (cmd->type == S9xNoMapping)
 		return;
 
-	if (maptype(keymap[id].type) != MAP_POINTER)
+	if (maptype(cmd->type) != MAP_POINTER)
 	{
-		fprintf(stderr, "ERROR: S9xReportPointer called on %s ID 0x%08x\n", maptypename(maptype(keymap[id].type)), id);
+		fprintf(stderr, "ERROR: S9xReportPointer called on %s ID 0x%08x\n", maptypename(maptype(cmd->type)), id);
 		return;
 	}
 
-	S9xApplyCommand(keymap[id], x, y);
+	S9xApplyCommand(*cmd, x, y);
 }
 
 bool S9xMapAxis (uint32 id, s9xcommand_t mapping, bool poll)
@@ -1910,7 +2048,7 @@ bool S9xMapAxis (uint32 id, s9xcommand_t mapping, bool poll)
 
 	S9xUnmapID(id);
 
-	keymap[id] = mapping;
+	keymap_set(id, mapping);
 
 	if (t >= 0)
 		pollmap[t].insert(id);
@@ -1920,19 +2058,118 @@ bool S9xMapAxis (uint32 id, s9xcommand_t mapping, bool poll)
 
 void S9xReportAxis (uint32 id, int16 value)
 {
-	if (keymap.count(id) == 0)
+	s9xcommand_t	*cmd = keymap_find(id);
+
+	if (!cmd)
 		return;
 
-	if (keymap[id].type == S9xNoMapping)
+	if (cmd->type == S9xNoMapping)
 		return;
 
-	if (maptype(keymap[id].type) != MAP_AXIS)
+	if (maptype(cmd->type) != MAP_AXIS)
 	{
-		fprintf(stderr, "ERROR: S9xReportAxis called on %s ID 0x%08x\n", maptypename(maptype(keymap[id].type)), id);
+		fprintf(stderr, "ERROR: S9xReportAxis called on %s ID 0x%08x\n", maptypename(maptype(cmd->type)), id);
 		return;
 	}
 
-	S9xApplyCommand(keymap[id], value, 0);
+	S9xApplyCommand(*cmd, value, 0);
+}
+
+// A single-producer, single-consumer ring: the port's input thread only moves
+// tail and the emulation thread only moves head, so neither needs a lock.
+
+static bool QueueInputEvent (uint32 id, uint8 type, int16 data1, int16 data2)
+{
+	uint32	tail = inputqueue.tail.load(std::memory_order_relaxed);
+
+	if (tail - inputqueue.head.load(std::memory_order_acquire) == INPUT_QUEUE_SIZE)
+		return (false);
+
+	input_event	&e = inputqueue.events[tail & (INPUT_QUEUE_SIZE - 1)];
+	e.id    = id;
+	e.type  = type;
+	e.data1 = data1;
+	e.data2 = data2;
+
+	inputqueue.tail.store(tail + 1, std::memory_order_release);
+
+	return (true);
+}
+
+bool S9xQueueButton (uint32 id, bool pressed)
+{
+	return (QueueInputEvent(id, MAP_BUTTON, pressed, 0));
+}
+
+bool S9xQueuePointer (uint32 id, int16 x, int16 y)
+{
+	return (QueueInputEvent(id, MAP_POINTER, x, y));
+}
+
+bool S9xQueueAxis (uint32 id, int16 value)
+{
+	return (QueueInputEvent(id, MAP_AXIS, value, 0));
+}
+
+// Commands, multis and port mappings may reset the system or load a state; the rest
+// only change what the controllers will report
+static bool8 InputEventIsCommand (const input_event &e)
+{
+	s9xcommand_t	*cmd = keymap_find(e.id);
+
+	if (!cmd)
+		return (FALSE);
+
+	switch (cmd->type)
+	{
+		case S9xButtonCommand:
+		case S9xButtonMulti:
+		case S9xButtonPort:
+		case S9xAxisPort:
+		case S9xPointerPort:
+			return (TRUE);
+
+		default:
+			return (FALSE);
+	}
+}
+
+static void ReportInputEvent (const input_event &e)
+{
+	switch (e.type)
+	{
+		case MAP_BUTTON:	S9xReportButton(e.id, e.data1 != 0);		break;
+		case MAP_POINTER:	S9xReportPointer(e.id, e.data1, e.data2);	break;
+		case MAP_AXIS:		S9xReportAxis(e.id, e.data1);				break;
+	}
+}
+
+// Runs on the emulation thread when the joypads are latched and at the end of each frame.
+// The latch happens inside a CPU write to $4016, so there commands are only set aside
+// and run, in order, by the next drain with commands set.
+static void DrainInputQueue (bool8 commands)
+{
+	uint32	head = inputqueue.head.load(std::memory_order_relaxed);
+	uint32	tail = inputqueue.tail.load(std::memory_order_acquire);
+
+	if (commands)
+	{
+		for (size_t i = 0; i < deferredinput.size(); i++)
+			ReportInputEvent(deferredinput[i]);
+
+		deferredinput.clear();
+	}
+
+	for (; head != tail; head++)
+	{
+		input_event	e = inputqueue.events[head & (INPUT_QUEUE_SIZE - 1)];
+		inputqueue.head.store(head + 1, std::memory_order_release);
+
+		if (!commands && InputEventIsCommand(e))
+			deferredinput.push_back(e);
+		else
+			ReportInputEvent(e);
+	}
 }
 
 static int32 ApplyMulti (s9xcommand_t *multi, int32 pos, int16 data1)
@@ -2728,7 +2965,12 @@ static void do_polling (int mp)
 
 	for (itr = pollmap[mp].begin(); itr != pollmap[mp].end(); itr++)
 	{
-		switch (maptype(keymap[*itr].type))
+		s9xcommand_t	*cmd = keymap_find(*itr);
+
+		if (!cmd)
+			continue;
+
+		switch (maptype(cmd->type))
 		{
 			case MAP_BUTTON:
 			{
@@ -2824,6 +3066,8 @@ void S9xSetJoypadLatch (bool latch)
 	{
 		int	i;
 
+		DrainInputQueue(FALSE);
+
 		for (int n = 0; n < 2; n++)
 		{
 			for (int j = 0; j < 2; j++)
@@ -3148,6 +3392,8 @@ void S9xControlEOF (void)
 	PPU.GunVLatch = 1000; // i.e., never latch
 	PPU.GunHLatch = 0;
 
+	DrainInputQueue(TRUE);
+
 	for (int n = 0; n < 2; n++)
 	{
 		switch (i = curcontrollers[n])
@@ -213,6 +213,16 @@ void S9xReportPointer (uint32 id, int16 x, int16 y);
 bool S9xMapAxis (uint32 id, s9xcommand_t mapping, bool poll);
 void S9xReportAxis (uint32 id, int16 value);
 
+// Queued reporting.
+// S9xQueueButton(), S9xQueuePointer() and S9xQueueAxis() can be called from an input thread other than the emulation thread.
+// The events are kept in a lock-free queue and reported by snes9x when the joypads are next latched or at the end of the frame.
+// Events mapped to commands, multis or port commands are only ever run at the end of the frame, never from inside a latch.
+// Only one thread may queue events. They return FALSE if the queue is full and the event was dropped.
+
+bool S9xQueueButton (uint32 id, bool pressed);
+bool S9xQueuePointer (uint32 id, int16 x, int16 y);
+bool S9xQueueAxis (uint32 id, int16 value);
+
 // Do whatever the s9xcommand_t says to do.
 // If cmd.type is a button type, data1 should be TRUE (non-0) or FALSE (0) to indicate whether the 'button' is pressed or released.
 // If cmd.type is an axis, data1 holds the deflection value.
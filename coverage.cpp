@@ -0,0 +1,145 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#include <algorithm>
+#include "snes9x.h"
+#include "memmap.h"
+#include "coverage.h"
+
+struct SCoverage	Coverage;
+
+void S9xCoverageInit (void)
+{
+	Coverage.FlagStorage.clear();
+	Coverage.HitStorage.clear();
+	Coverage.ROM = NULL;
+	Coverage.Size = 0;
+	Coverage.Flags = NULL;
+	Coverage.Hits = NULL;
+
+	if (!Settings.CodeCoverage || !Memory.CalculatedSize)
+		return;
+
+	Coverage.FlagStorage.resize(Memory.CalculatedSize);
+	Coverage.HitStorage.resize(Memory.CalculatedSize);
+	Coverage.ROM = Memory.ROM;
+	Coverage.Size = Memory.CalculatedSize;
+	Coverage.Flags = Coverage.FlagStorage.data();
+	Coverage.Hits = Coverage.HitStorage.data();
+
+	S9xCoverageRefresh();
+}
+
+void S9xCoverageReset (void)
+{
+	std::fill(Coverage.FlagStorage.begin(), Coverage.FlagStorage.end(), 0);
+	std::fill(Coverage.HitStorage.begin(), Coverage.HitStorage.end(), 0);
+}
+
+// Data reads are counted by pointing the Map entries of every ROM block at the
+// MAP_COVERAGE sentinel, as watchpoints do, so the S9xGetByte/S9xGetWord fast
+// paths stay untouched. Opcode fetches and DMA see through the sentinel and are
+// marked by S9xCoverageMarkInstruction and S9xCoverageMarkDMA instead.
+// Called after the memory map has been rebuilt and the sentinels were lost.
+void S9xCoverageRefresh (void)
+{
+	if (!Coverage.Size)
+		return;
+
+	for (int b = 0; b < MEMMAP_NUM_BLOCKS; b++)
+	{
+		if (Memory.BlockIsROM[b] && Memory.Map[b] >= (uint8 *) CMemory::MAP_LAST)
+		{
+			Coverage.Map[b] = Memory.Map[b];
+			Memory.Map[b] = (uint8 *) CMemory::MAP_COVERAGE;
+		}
+	}
+}
+
+uint8 S9xCoverageGetByte (uint32 Address)
+{
+	uint8	*GetAddress = Coverage.Map[(Address & 0xffffff) >> MEMMAP_SHIFT] + (Address & 0xffff);
+	int32	speed = memory_speed(Address);
+
+	S9xCoverageMark(GetAddress, CPU.InDMAorHDMA ? CDL_DMA : CDL_DATA);
+	addCyclesInMemoryAccess;
+
+	return (*GetAddress);
+}
+
+uint16 S9xCoverageGetWord (uint32 Address)
+{
+	uint8	*GetAddress = Coverage.Map[(Address & 0xffffff) >> MEMMAP_SHIFT] + (Address & 0xffff);
+	int32	speed = memory_speed(Address);
+
+	S9xCoverageMark(GetAddress, CDL_DATA);
+	S9xCoverageMark(GetAddress + 1, CDL_DATA);
+	addCyclesInMemoryAccess_x2;
+
+	return (READ_WORD(GetAddress));
+}
+
+// Called before the instruction at PB:PC is executed, with the opcode already fetched
+void S9xCoverageMarkInstruction (uint8 Op)
+{
+	uint8	mx = (CheckMemory() ? CDL_M8 : CDL_M16) | (CheckIndex() ? CDL_X8 : CDL_X16);
+	uint8	*p = S9xGetMemPointer(Registers.PBPC);
+
+	if (p)
+		S9xCoverageMark(p, CDL_OPCODE | mx);
+
+	for (int i = 1; i < ICPU.S9xOpLengths[Op]; i++)
+	{
+		p = S9xGetMemPointer(ICPU.ShiftedPB + ((Registers.PCw + i) & 0xffff));
+		if (p)
+			S9xCoverageMark(p, CDL_OPERAND | mx);
+	}
+}
+
+// Marks one block-bounded chunk of a general purpose DMA read from base + p
+void S9xCoverageMarkDMA (uint8 *base, uint16 p, int32 count, int32 inc)
+{
+	for (int32 i = 0; i < count; i++, p += inc)
+		S9xCoverageMark(base + p, CDL_DMA);
+}
+
+bool8 S9xCoverageSaveCDL (const char *filename)
+{
+	if (!Coverage.Size)
+		return (FALSE);
+
+	FILE	*fp = fopen(filename, "wb");
+	if (!fp)
+		return (FALSE);
+
+	size_t	written = fwrite(Coverage.Flags, 1, Coverage.Size, fp);
+	fclose(fp);
+
+	return (written == Coverage.Size);
+}
+
+// Text heatmap, one line per ROM byte that was touched: offset, hit count, CDL flags
+bool8 S9xCoverageSaveHeatmap (const char *filename)
+{
+	if (!Coverage.Size)
+		return (FALSE);
+
+	FILE	*fp = fopen(filename, "w");
+	if (!fp)
+		return (FALSE);
+
+	fprintf(fp, "offset,hits,flags\n");
+
+	for (uint32 i = 0; i < Coverage.Size; i++)
+	{
+		if (Coverage.Hits[i])
+			fprintf(fp, "%06X,%u,%02X\n", i, Coverage.Hits[i], Coverage.Flags[i]);
+	}
+
+	fclose(fp);
+
+	return (TRUE);
+}
@@ -0,0 +1,59 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#ifndef _COVERAGE_H_
+#define _COVERAGE_H_
+
+#include <vector>
+
+// Per-ROM-byte usage flags, written as-is to the .cdl file
+enum
+{
+	CDL_OPCODE		= 0x01,	// first byte of an executed instruction
+	CDL_OPERAND		= 0x02,	// operand byte of an executed instruction
+	CDL_DATA		= 0x04,	// read by the CPU as data
+	CDL_DMA			= 0x08,	// read by DMA or HDMA
+	CDL_M8			= 0x10,	// executed with 8-bit accumulator/memory
+	CDL_M16			= 0x20,	// executed with 16-bit accumulator/memory
+	CDL_X8			= 0x40,	// executed with 8-bit index registers
+	CDL_X16			= 0x80	// executed with 16-bit index registers
+};
+
+struct SCoverage
+{
+	uint8	*ROM;
+	uint32	Size;
+	uint8	*Flags;
+	uint32	*Hits;
+	std::vector<uint8>	FlagStorage;
+	std::vector<uint32>	HitStorage;
+	uint8	*Map[MEMMAP_NUM_BLOCKS];	// Map entries of the ROM blocks redirected to MAP_COVERAGE
+};
+
+extern struct SCoverage	Coverage;
+
+void S9xCoverageInit (void);
+void S9xCoverageReset (void);
+void S9xCoverageRefresh (void);
+uint8 S9xCoverageGetByte (uint32);
+uint16 S9xCoverageGetWord (uint32);
+void S9xCoverageMarkInstruction (uint8);
+void S9xCoverageMarkDMA (uint8 *, uint16, int32, int32);
+bool8 S9xCoverageSaveCDL (const char *);
+bool8 S9xCoverageSaveHeatmap (const char *);
+
+static inline void S9xCoverageMark (const uint8 *p, uint8 flags)
+{
+	size_t	offset = (size_t) (p - Coverage.ROM);
+
+	if (offset < Coverage.Size)
+	{
+		Coverage.Flags[offset] |= flags;
+		Coverage.Hits[offset]++;
+	}
+}
+
+#endif
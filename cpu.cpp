@@ -101,6 +101,7 @@ void S9xReset (void)
 	memset(Memory.RAM, 0x55, sizeof(Memory.RAM));
 	memset(Memory.VRAM, 0x00, sizeof(Memory.VRAM));
 	memset(Memory.FillRAM, 0, 0x8000);
+	Memory.MarkAllDirty();
 
 	S9xResetBSX();
 	S9xResetCPU();
@@ -136,6 +137,7 @@ void S9xSoftReset (void)
 	S9xResetSaveTimer(FALSE);
 
 	memset(Memory.FillRAM, 0, 0x8000);
+	Memory.MarkAllDirty();
 
 	if (Settings.BS)
 		S9xResetBSX();
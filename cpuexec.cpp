@@ -12,6 +12,7 @@
 #include "fxemu.h"
 #include "snapshot.h"
 #include "movie.h"
+#include "perfcounters.h"
 #ifdef DEBUGGER
 #include "debug.h"
 #include "missing.h"
@@ -160,6 +161,11 @@ void S9xMainLoop (void)
 				Opcodes = S9xOpcodesSlow;
 		}
 
+		if (Settings.CodeCoverage)
+			S9xCoverageMarkInstruction(Op);
+
+		S9xPerfAdd(PERF_CPU_INSTRUCTIONS, 1);
+
 		Registers.PCw++;
 		(*Opcodes[Op].S9xOpcode)();
 
@@ -248,11 +254,7 @@ void S9xDoHEventProcessing (void)
 
 		case HC_HCOUNTER_MAX_EVENT:
 			if (Settings.SuperFX)
-			{
-				if (!SuperFX.oneLineDone)
-					S9xSuperFXExec();
-				SuperFX.oneLineDone = FALSE;
-			}
+				S9xSuperFXExec();
 
 			S9xAPUEndScanline();
 			CPU.Cycles -= Timings.H_Max;
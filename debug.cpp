@@ -7,6 +7,7 @@
 #ifdef DEBUGGER
 
 #include <stdarg.h>
+#include <ctype.h>
 #include "snes9x.h"
 #include "memmap.h"
 #include "cpuops.h"
@@ -23,6 +24,11 @@ extern FILE	*apu_trace;
 FILE		*trace = NULL, *trace2 = NULL;
 
 struct SBreakPoint	S9xBreakpoint[6];
+struct SWatchPoint	S9xWatchpoint[WATCHPOINT_COUNT];
+
+// Original Map/WriteMap entries of the blocks currently redirected to MAP_WATCH
+static uint8	*WatchMap[MEMMAP_NUM_BLOCKS];
+static uint8	*WatchWriteMap[MEMMAP_NUM_BLOCKS];
 
 struct SDebug
 {
@@ -66,6 +72,15 @@ static const char	*HelpMessage[] =
 	"bs [Number] [Address]  - Enable/disable breakpoint",
 	"                         [enable example: bs #2 $02:8002]",
 	"                         [disable example: bs #2]",
+	"mv [Number]            - View watchpoints or view watchpoint [Number]",
+	"ms [Number] [Address] [Options]",
+	"                       - Enable/disable memory watchpoint",
+	"                         [Options: +Length r|w|rw .b|.w =$Value ! l]",
+	"                         [=$Value: break when the accessed value equals Value]",
+	"                         [!: break when a write changes the value]",
+	"                         [l: log hits to trace.log instead of breaking]",
+	"                         [enable example: ms #1 $7E:0DBF +2 w .w !]",
+	"                         [disable example: ms #1]",
 	"c                      - Dump SNES colour palette",
 	"W                      - Show what SNES hardware features the ROM is using",
 	"                         which might not be implemented yet",
@@ -161,6 +176,8 @@ static void debug_print_window (uint8 *);
 static const char * debug_clip_fn (int);
 static void debug_whats_used (void);
 static void debug_whats_missing (void);
+static void debug_watch_print (int);
+static void debug_watch_check (uint32, int, uint16, uint16, uint8);
 
 
 static uint8 S9xDebugGetByte (uint32 Address)
@@ -195,6 +212,16 @@ static uint8 S9xDebugGetByte (uint32 Address)
 			byte = *(Memory.BWRAM + ((Address & 0x7fff) - 0x6000));
 			return (byte);
 
+		case CMemory::MAP_COVERAGE:
+			byte = *(Coverage.Map[block] + (Address & 0xffff));
+			return (byte);
+
+		case CMemory::MAP_WATCH:
+			Memory.Map[block] = WatchMap[block];
+			byte = S9xDebugGetByte(Address);
+			Memory.Map[block] = (uint8 *) CMemory::MAP_WATCH;
+			return (byte);
+
 		default:
 			return (byte);
 	}
@@ -1190,6 +1217,94 @@ static short debug_get_start_address (char *Line, uint8 *Bank, uint32 *Address)
 	return (1);
 }
 
+static void debug_watch_print (int n)
+{
+	struct SWatchPoint	*wp = &S9xWatchpoint[n];
+	char				string[128];
+
+	if (!wp->Enabled)
+	{
+		sprintf(string, "%i @ Disabled", n);
+		debug_line_print(string);
+		return;
+	}
+
+	sprintf(string, "%i @ $%02X:%04X +%d %s%s %s", n, wp->Address >> 16, wp->Address & 0xffff, wp->Length,
+			(wp->Access & WATCH_READ) ? "r" : "", (wp->Access & WATCH_WRITE) ? "w" : "",
+			wp->Size == 1 ? ".b" : (wp->Size == 2 ? ".w" : "any"));
+
+	if (wp->Condition == WATCH_EQUALS)
+		sprintf(string + strlen(string), " =$%04X", wp->Value);
+	else
+	if (wp->Condition == WATCH_CHANGES)
+		strcat(string, " !");
+
+	sprintf(string + strlen(string), " %s, %u hits", wp->LogOnly ? "log" : "break", wp->Hits);
+
+	debug_line_print(string);
+}
+
+// Checks an access of Size bytes at Address against every enabled watchpoint.
+// Old is the previous memory content for writes and is ignored for reads.
+static void debug_watch_check (uint32 Address, int Size, uint16 Value, uint16 Old, uint8 Access)
+{
+	Address &= 0xffffff;
+
+	for (int i = 0; i < WATCHPOINT_COUNT; i++)
+	{
+		struct SWatchPoint	*wp = &S9xWatchpoint[i];
+
+		if (!wp->Enabled || !(wp->Access & Access) || (wp->Size && wp->Size != Size))
+			continue;
+
+		if (Address + Size <= wp->Address || Address >= wp->Address + wp->Length)
+			continue;
+
+		bool8	hit;
+
+		switch (wp->Condition)
+		{
+			case WATCH_EQUALS:
+				hit = (Value == wp->Value);
+				break;
+
+			case WATCH_CHANGES:
+				hit = (Value != ((Access == WATCH_WRITE) ? Old : wp->Last[Size - 1]));
+				break;
+
+			default:
+				hit = TRUE;
+				break;
+		}
+
+		wp->Last[Size - 1] = Value;
+
+		if (!hit)
+			continue;
+
+		char	msg[192], pos[64];
+
+		wp->Hits++;
+		S9xPrintHVPosition(pos);
+		sprintf(msg, "Watchpoint %d: %s %s $%02X:%04X = $%0*X by %s at $%02X:%04X %s", i,
+				(Access == WATCH_WRITE) ? "write" : "read", Size == 2 ? "word" : "byte",
+				Address >> 16, Address & 0xffff, Size * 2, Value,
+				CPU.InHDMA ? "HDMA" : (CPU.InDMA ? "DMA" : "CPU"),
+				Registers.PB, Registers.PCw, pos);
+
+		if (wp->LogOnly)
+		{
+			ENSURE_TRACE_OPEN(trace, "trace.log", "a")
+			fprintf(trace, "%s\n", msg);
+		}
+		else
+		{
+			debug_line_print(msg);
+			CPU.Flags |= DEBUG_MODE_FLAG;
+		}
+	}
+}
+
 void S9xDebugProcessCommand(char *Line)
 {
 	uint8	Bank = Registers.PB;
@@ -1564,6 +1679,100 @@ void S9xDebugProcessCommand(char *Line)
 		}
 	}
 
+	if (*Line == 'm')
+	{
+		if (Line[1] == 's')
+		{
+			debug_get_number(Line + 2, &Hold);
+
+			if (Hold >= WATCHPOINT_COUNT)
+				Hold = 0;
+
+			struct SWatchPoint	*wp = &S9xWatchpoint[Hold];
+
+			if (debug_get_start_address(Line + 5, &Bank, &Address) == -1)
+				wp->Enabled = FALSE;
+			else
+			{
+				wp->Enabled = TRUE;
+				wp->Address = (Bank << 16) | (Address & 0xffff);
+				wp->Length = 1;
+				wp->Access = WATCH_READ | WATCH_WRITE;
+				wp->Size = 0;
+				wp->Condition = WATCH_ANY;
+				wp->Value = 0;
+				wp->Last[0] = S9xDebugGetByte(wp->Address);
+				wp->Last[1] = S9xDebugGetWord(wp->Address);
+				wp->LogOnly = FALSE;
+				wp->Hits = 0;
+
+				char	*opt = strchr(Line + 5, '$');
+				while (*opt && !isspace(*opt))
+					opt++;
+
+				for (opt = strtok(opt, " \t"); opt; opt = strtok(NULL, " \t"))
+				{
+					int		n;
+					uint32	v;
+
+					if (*opt == '+' && sscanf(opt + 1, "%d", &n) == 1 && n > 0)
+						wp->Length = n;
+					else
+					if (strcasecmp(opt, "r") == 0)
+						wp->Access = WATCH_READ;
+					else
+					if (strcasecmp(opt, "w") == 0)
+						wp->Access = WATCH_WRITE;
+					else
+					if (strcasecmp(opt, "rw") == 0)
+						wp->Access = WATCH_READ | WATCH_WRITE;
+					else
+					if (strcasecmp(opt, ".b") == 0)
+						wp->Size = 1;
+					else
+					if (strcasecmp(opt, ".w") == 0)
+						wp->Size = 2;
+					else
+					if (*opt == '=' && sscanf(opt + 1, " $%x", &v) == 1)
+					{
+						wp->Condition = WATCH_EQUALS;
+						wp->Value = v;
+					}
+					else
+					if (*opt == '!')
+						wp->Condition = WATCH_CHANGES;
+					else
+					if (strcasecmp(opt, "l") == 0)
+						wp->LogOnly = TRUE;
+					else
+						printf("Unknown watchpoint option: %s\n", opt);
+				}
+			}
+
+			S9xUpdateWatchpoints();
+
+			sprintf(Line, "mv #%d", Hold);
+		}
+
+		if (Line[1] == 'v')
+		{
+			Number = 0;
+
+			if (debug_get_number(Line + 2, &Number) == -1 || Number >= WATCHPOINT_COUNT)
+			{
+				debug_line_print("Watchpoints:");
+
+				for (Number = 0; Number != WATCHPOINT_COUNT; Number++)
+					debug_watch_print(Number);
+			}
+			else
+			{
+				debug_line_print("Watchpoint:");
+				debug_watch_print(Number);
+			}
+		}
+	}
+
 	if (*Line == '?' || strcasecmp(Line, "help") == 0)
 	{
 		for (int i = 0; HelpMessage[i] != NULL; i++)
@@ -2445,6 +2654,174 @@ void S9xTraceFormattedMessage (const char *s, ...)
 	}
 }
 
+// Watchpoints are implemented by pointing the Map/WriteMap entries of every
+// watched 4KB block at the MAP_WATCH sentinel, so the fast paths for all other
+// memory stay untouched. Blocks are restored when no watchpoint covers them.
+void S9xUpdateWatchpoints (void)
+{
+	uint8	access[MEMMAP_NUM_BLOCKS];
+
+	memset(access, 0, sizeof(access));
+
+	for (int i = 0; i < WATCHPOINT_COUNT; i++)
+	{
+		struct SWatchPoint	*wp = &S9xWatchpoint[i];
+
+		if (!wp->Enabled)
+			continue;
+
+		uint32	first = (wp->Address & 0xffffff) >> MEMMAP_SHIFT;
+		uint32	last = ((wp->Address + wp->Length - 1) & 0xffffff) >> MEMMAP_SHIFT;
+
+		for (uint32 b = first; ; b = (b + 1) % MEMMAP_NUM_BLOCKS)
+		{
+			access[b] |= wp->Access;
+			if (b == last)
+				break;
+		}
+	}
+
+	for (int b = 0; b < MEMMAP_NUM_BLOCKS; b++)
+	{
+		bool8	watched = (Memory.Map[b] == (uint8 *) CMemory::MAP_WATCH);
+
+		if ((access[b] & WATCH_READ) && !watched)
+		{
+			WatchMap[b] = Memory.Map[b];
+			Memory.Map[b] = (uint8 *) CMemory::MAP_WATCH;
+		}
+		else
+		if (!(access[b] & WATCH_READ) && watched)
+			Memory.Map[b] = WatchMap[b];
+
+		watched = (Memory.WriteMap[b] == (uint8 *) CMemory::MAP_WATCH);
+
+		if ((access[b] & WATCH_WRITE) && !watched)
+		{
+			WatchWriteMap[b] = Memory.WriteMap[b];
+			Memory.WriteMap[b] = (uint8 *) CMemory::MAP_WATCH;
+		}
+		else
+		if (!(access[b] & WATCH_WRITE) && watched)
+			Memory.WriteMap[b] = WatchWriteMap[b];
+	}
+
+	// Opcode fetches must not bypass the sentinel through a stale PCBase
+	S9xSetPCBase(Registers.PBPC);
+}
+
+// Called after the memory map has been rebuilt and the sentinels were lost
+void S9xRefreshWatchpoints (void)
+{
+	for (int i = 0; i < WATCHPOINT_COUNT; i++)
+	{
+		if (S9xWatchpoint[i].Enabled)
+		{
+			S9xUpdateWatchpoints();
+			return;
+		}
+	}
+}
+
+uint8 S9xWatchpointGetByte (uint32 Address)
+{
+	int		block = (Address & 0xffffff) >> MEMMAP_SHIFT;
+	uint8	*GetAddress = WatchMap[block];
+	uint8	byte;
+
+	if (GetAddress >= (uint8 *) CMemory::MAP_LAST)
+	{
+		int32	speed = memory_speed(Address);
+
+		byte = *(GetAddress + (Address & 0xffff));
+		addCyclesInMemoryAccess;
+	}
+	else
+	{
+		Memory.Map[block] = GetAddress;
+		byte = S9xGetByte(Address);
+		Memory.Map[block] = (uint8 *) CMemory::MAP_WATCH;
+	}
+
+	debug_watch_check(Address, 1, byte, 0, WATCH_READ);
+
+	return (byte);
+}
+
+uint16 S9xWatchpointGetWord (uint32 Address)
+{
+	int		block = (Address & 0xffffff) >> MEMMAP_SHIFT;
+	uint8	*GetAddress = WatchMap[block];
+	uint16	word;
+
+	if (GetAddress >= (uint8 *) CMemory::MAP_LAST)
+	{
+		int32	speed = memory_speed(Address);
+
+		word = READ_WORD(GetAddress + (Address & 0xffff));
+		addCyclesInMemoryAccess_x2;
+	}
+	else
+	{
+		Memory.Map[block] = GetAddress;
+		word = S9xGetWord(Address);
+		Memory.Map[block] = (uint8 *) CMemory::MAP_WATCH;
+	}
+
+	debug_watch_check(Address, 2, word, 0, WATCH_READ);
+
+	return (word);
+}
+
+void S9xWatchpointSetByte (uint8 Byte, uint32 Address)
+{
+	int		block = (Address & 0xffffff) >> MEMMAP_SHIFT;
+	uint8	*SetAddress = WatchWriteMap[block];
+	uint8	old = S9xDebugGetByte(Address);
+
+	if (SetAddress >= (uint8 *) CMemory::MAP_LAST)
+	{
+		int32	speed = memory_speed(Address);
+
+		*(SetAddress + (Address & 0xffff)) = Byte;
+		S9xMarkDirtyPage(SetAddress + (Address & 0xffff));
+		addCyclesInMemoryAccess;
+	}
+	else
+	{
+		Memory.WriteMap[block] = SetAddress;
+		S9xSetByte(Byte, Address);
+		Memory.WriteMap[block] = (uint8 *) CMemory::MAP_WATCH;
+	}
+
+	debug_watch_check(Address, 1, Byte, old, WATCH_WRITE);
+}
+
+void S9xWatchpointSetWord (uint16 Word, uint32 Address, int o)
+{
+	int		block = (Address & 0xffffff) >> MEMMAP_SHIFT;
+	uint8	*SetAddress = WatchWriteMap[block];
+	uint16	old = S9xDebugGetWord(Address);
+
+	if (SetAddress >= (uint8 *) CMemory::MAP_LAST)
+	{
+		int32	speed = memory_speed(Address);
+
+		WRITE_WORD(SetAddress + (Address & 0xffff), Word);
+		S9xMarkDirtyPage(SetAddress + (Address & 0xffff));
+		S9xMarkDirtyPage(SetAddress + (Address & 0xffff) + 1);
+		addCyclesInMemoryAccess_x2;
+	}
+	else
+	{
+		Memory.WriteMap[block] = SetAddress;
+		S9xSetWord(Word, Address, WRAP_NONE, o ? WRITE_10 : WRITE_01);
+		Memory.WriteMap[block] = (uint8 *) CMemory::MAP_WATCH;
+	}
+
+	debug_watch_check(Address, 2, Word, old, WATCH_WRITE);
+}
+
 void S9xPrintHVPosition (char *s)
 {
 	sprintf(s, "HC:%04ld VC:%03ld FC:%02d", (long) CPU.Cycles, (long) CPU.V_Counter, IPPU.FrameCount);
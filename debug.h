@@ -18,6 +18,35 @@ struct SBreakPoint
 	uint16	Address;
 };
 
+enum
+{
+	WATCH_READ    = 1,
+	WATCH_WRITE   = 2
+};
+
+enum
+{
+	WATCH_ANY,
+	WATCH_EQUALS,
+	WATCH_CHANGES
+};
+
+struct SWatchPoint
+{
+	bool8	Enabled;
+	uint32	Address;
+	uint16	Length;
+	uint8	Access;		// WATCH_READ | WATCH_WRITE
+	uint8	Size;		// 0 = any, 1 = byte, 2 = word
+	uint8	Condition;
+	uint16	Value;
+	uint16	Last[2];	// last value read as a byte, as a word
+	bool8	LogOnly;
+	uint32	Hits;
+};
+
+#define WATCHPOINT_COUNT	8
+
 #define ENSURE_TRACE_OPEN(fp, file, mode) \
 	if (!fp) \
 	{ \
@@ -27,6 +56,7 @@ struct SBreakPoint
 	}
 
 extern struct SBreakPoint	S9xBreakpoint[6];
+extern struct SWatchPoint	S9xWatchpoint[WATCHPOINT_COUNT];
 
 void S9xDoDebug (void);
 void S9xTrace (void);
@@ -35,6 +65,12 @@ void S9xTraceMessage (const char *);
 void S9xTraceFormattedMessage (const char *, ...);
 void S9xPrintHVPosition (char *);
 void S9xDebugProcessCommand(char *);
+void S9xUpdateWatchpoints (void);
+void S9xRefreshWatchpoints (void);
+uint8 S9xWatchpointGetByte (uint32);
+uint16 S9xWatchpointGetWord (uint32);
+void S9xWatchpointSetByte (uint8, uint32);
+void S9xWatchpointSetWord (uint16, uint32, int);
 
 #endif
 
@@ -10,6 +10,7 @@
 #include "apu/apu.h"
 #include "sdd1emu.h"
 #include "spc7110emu.h"
+#include "perfcounters.h"
 #ifdef DEBUGGER
 #include "missing.h"
 #endif
@@ -122,6 +123,8 @@ bool8 S9xDoDMA (uint8 Channel)
 	if (count == 0)
 		count = 0x10000;
 
+	S9xPerfAdd(PERF_DMA_BYTES, count);
+
 	// Prepare for custom chip DMA
 
 	// S-DD1
@@ -219,98 +222,17 @@ bool8 S9xDoDMA (uint8 Channel)
 				depth, count, bytes_per_char, bytes_per_line, num_chars, char_line_bytes);
 		#endif
 
-			switch (depth)
+			for (int32 i = 0; i < count; i += inc_sa1, base += char_line_bytes, inc_sa1 = char_line_bytes, char_count = num_chars)
 			{
-				case 2:
-					for (int32 i = 0; i < count; i += inc_sa1, base += char_line_bytes, inc_sa1 = char_line_bytes, char_count = num_chars)
-					{
-						uint8	*line = base + (num_chars - char_count) * 2;
-						for (uint32 j = 0; j < char_count && p - buffer < count; j++, line += 2)
-						{
-							uint8	*q = line;
-							for (int32 l = 0; l < 8; l++, q += bytes_per_line)
-							{
-								for (int32 b = 0; b < 2; b++)
-								{
-									uint8	r = *(q + b);
-									*(p + 0) = (*(p + 0) << 1) | ((r >> 0) & 1);
-									*(p + 1) = (*(p + 1) << 1) | ((r >> 1) & 1);
-									*(p + 0) = (*(p + 0) << 1) | ((r >> 2) & 1);
-									*(p + 1) = (*(p + 1) << 1) | ((r >> 3) & 1);
-									*(p + 0) = (*(p + 0) << 1) | ((r >> 4) & 1);
-									*(p + 1) = (*(p + 1) << 1) | ((r >> 5) & 1);
-									*(p + 0) = (*(p + 0) << 1) | ((r >> 6) & 1);
-									*(p + 1) = (*(p + 1) << 1) | ((r >> 7) & 1);
-								}
-
-								p += 2;
-							}
-						}
-					}
-
-					break;
-
-				case 4:
-					for (int32 i = 0; i < count; i += inc_sa1, base += char_line_bytes, inc_sa1 = char_line_bytes, char_count = num_chars)
-					{
-						uint8	*line = base + (num_chars - char_count) * 4;
-						for (uint32 j = 0; j < char_count && p - buffer < count; j++, line += 4)
-						{
-							uint8	*q = line;
-							for (int32 l = 0; l < 8; l++, q += bytes_per_line)
-							{
-								for (int32 b = 0; b < 4; b++)
-								{
-									uint8	r = *(q + b);
-									*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-									*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-									*(p + 16) = (*(p + 16) << 1) | ((r >> 2) & 1);
-									*(p + 17) = (*(p + 17) << 1) | ((r >> 3) & 1);
-									*(p +  0) = (*(p +  0) << 1) | ((r >> 4) & 1);
-									*(p +  1) = (*(p +  1) << 1) | ((r >> 5) & 1);
-									*(p + 16) = (*(p + 16) << 1) | ((r >> 6) & 1);
-									*(p + 17) = (*(p + 17) << 1) | ((r >> 7) & 1);
-								}
-
-								p += 2;
-							}
-
-							p += 32 - 16;
-						}
-					}
-
-					break;
-
-				case 8:
-					for (int32 i = 0; i < count; i += inc_sa1, base += char_line_bytes, inc_sa1 = char_line_bytes, char_count = num_chars)
-					{
-						uint8	*line = base + (num_chars - char_count) * 8;
-						for (uint32 j = 0; j < char_count && p - buffer < count; j++, line += 8)
-						{
-							uint8	*q = line;
-							for (int32 l = 0; l < 8; l++, q += bytes_per_line)
-							{
-								for (int32 b = 0; b < 8; b++)
-								{
-									uint8	r = *(q + b);
-									*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-									*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-									*(p + 16) = (*(p + 16) << 1) | ((r >> 2) & 1);
-									*(p + 17) = (*(p + 17) << 1) | ((r >> 3) & 1);
-									*(p + 32) = (*(p + 32) << 1) | ((r >> 4) & 1);
-									*(p + 33) = (*(p + 33) << 1) | ((r >> 5) & 1);
-									*(p + 48) = (*(p + 48) << 1) | ((r >> 6) & 1);
-									*(p + 49) = (*(p + 49) << 1) | ((r >> 7) & 1);
-								}
-
-								p += 2;
-							}
-
-							p += 64 - 16;
-						}
-					}
+				uint8	*line = base + (num_chars - char_count) * depth;
+				for (uint32 j = 0; j < char_count && p - buffer < count; j++, line += depth)
+				{
+					uint8	*q = line;
+					for (int32 l = 0; l < 8; l++, q += bytes_per_line, p += 2)
+						S9xSA1PlanarRow(p, S9xSA1PixelRow(q, depth), depth);
 
-					break;
+					p += bytes_per_char - 16;
+				}
 			}
 		}
 	}
@@ -402,6 +324,9 @@ bool8 S9xDoDMA (uint8 Channel)
 
 			CPU.InWRAMDMAorHDMA = inWRAM_DMA;
 
+			if (Settings.CodeCoverage && base && !in_sa1_dma && !in_sdd1_dma && !spc7110_dma)
+				S9xCoverageMarkDMA(base, p, count, inc);
+
 			if (!base)
 			{
 				// DMA SLOW PATH
@@ -1276,6 +1201,8 @@ uint8 S9xDoHDMA (uint8 byte)
 
 			if (p->DoTransfer)
 			{
+				S9xPerfAdd(PERF_HDMA_LINES, 1);
+
 				// XXX: Hack for Uniracers, because we don't understand
 				// OAM Address Invalidation
 				if (p->BAddress == 0x04)
@@ -1438,6 +1365,12 @@ uint8 S9xDoHDMA (uint8 byte)
 						else
 						{
 							// HDMA FAST PATH
+							if (Settings.CodeCoverage)
+							{
+								for (int i = 0; i < HDMA_ModeByteCounts[p->TransferMode]; i++)
+									S9xCoverageMark(HDMAMemPointers[d] + i, CDL_DMA);
+							}
+
 							switch (p->TransferMode)
 							{
 								case 0:
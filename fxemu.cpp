@@ -8,6 +8,13 @@
 #include "memmap.h"
 #include "fxinst.h"
 #include "fxemu.h"
+#include "perfcounters.h"
+
+// The most credit a saved state can hold: a line's worth at the highest clock
+#define FX_MAX_SAVED_CYCLES	8192
+// A register read catches the GSU up only once it is owed this much, so that
+// a CPU polling SFR doesn't re-enter the GSU for every handful of cycles
+#define FX_READ_SYNC_CYCLES	64
 
 static void FxReset (struct FxInfo_s *);
 static void fx_readRegisterSpace (void);
@@ -15,22 +22,29 @@ static void fx_writeRegisterSpace (void);
 static void fx_updateRamBank (uint8);
 static void fx_dirtySCBR (void);
 static bool8 fx_checkStartAddress (void);
-static uint32 FxEmulate (uint32);
+static int32 FxEmulate (int32);
+static void FxSync (int32);
 static void FxCacheWriteAccess (uint16);
 static void FxFlushCache (void);
+static void fx_buildScreenLayouts (void);
 
 
 void S9xInitSuperFX (void)
 {
 	memset((uint8 *) &GSU, 0, sizeof(struct FxRegs_s));
+	fx_buildScreenLayouts();
+	fx_buildCycleTables();
 }
 
 void S9xResetSuperFX (void)
 {
-	// FIXME: Snes9x only runs the SuperFX at the end of every line.
-	// 5823405 is a magic number that seems to work for most games.
+	// Without Settings.SuperFXCycleCosts every instruction costs one cycle and
+	// the GSU gets the 5823405 instructions per second Snes9x has always given it,
+	// 5/2 as many at 21 MHz
 	SuperFX.speedPerLine = (uint32) (5823405 * ((1.0 / (float) Memory.ROMFramesPerSecond) / ((float) (Timings.V_Max))));
-	SuperFX.oneLineDone = FALSE;
+	SuperFX.cycles = 0;
+	SuperFX.cycleBase = CPU.Cycles;
+	SuperFX.cycleRemainder = 0;
 	SuperFX.vFlags = 0;
 	CPU.IRQExternal = FALSE;
 	FxReset(&SuperFX);
@@ -38,21 +52,16 @@ void S9xResetSuperFX (void)
 
 void S9xSetSuperFX (uint8 byte, uint16 address)
 {
+	// Every write may start, stop or reconfigure the GSU, so it first runs up to now
+	FxSync(1);
+
 	switch (address)
 	{
 		case 0x3030:
 			if ((Memory.FillRAM[0x3030] ^ byte) & FLG_G)
 			{
 				Memory.FillRAM[0x3030] = byte;
-				if (byte & FLG_G)
-				{
-					if (!SuperFX.oneLineDone)
-					{
-						S9xSuperFXExec();
-						SuperFX.oneLineDone = TRUE;
-					}
-				}
-				else
+				if (!(byte & FLG_G))
 					FxFlushCache();
 			}
 			else
@@ -108,12 +117,6 @@ void S9xSetSuperFX (uint8 byte, uint16 address)
 		case 0x301f:
 			Memory.FillRAM[0x301f] = byte;
 			Memory.FillRAM[0x3000 + GSU_SFR] |= FLG_G;
-			if (!SuperFX.oneLineDone)
-			{
-				S9xSuperFXExec();
-				SuperFX.oneLineDone = TRUE;
-			}
-
 			break;
 
 		default:
@@ -129,6 +132,8 @@ uint8 S9xGetSuperFX (uint16 address)
 {
 	uint8	byte;
 
+	FxSync(FX_READ_SYNC_CYCLES);
+
 	byte = Memory.FillRAM[address];
 
 	if (address == 0x3031)
@@ -140,15 +145,104 @@ uint8 S9xGetSuperFX (uint16 address)
 	return (byte);
 }
 
-void S9xSuperFXExec (void)
+static bool8 FxRunning (void)
 {
-	if ((Memory.FillRAM[0x3000 + GSU_SFR] & FLG_G) && (Memory.FillRAM[0x3000 + GSU_SCMR] & 0x18) == 0x18)
+	return ((Memory.FillRAM[0x3000 + GSU_SFR] & FLG_G) && (Memory.FillRAM[0x3000 + GSU_SCMR] & 0x18) == 0x18);
+}
+
+// What cycleRemainder counts up to before it makes one more GSU cycle
+static uint32 FxCycleDivisor (void)
+{
+	// one-cycle instructions: speedPerLine per line, or 5/2 of that with CLSR set
+	if (!Settings.SuperFXCycleCosts)
+		return ((Memory.FillRAM[0x3000 + GSU_CLSR] & 1) ? 40 * SNES_CYCLES_PER_SCANLINE : 100 * SNES_CYCLES_PER_SCANLINE);
+
+	return ((Memory.FillRAM[0x3000 + GSU_CLSR] & 1) ? 100 : 200);
+}
+
+// Turns the master cycles since the last call into GSU cycles the GSU is owed.
+// The GSU runs at the master clock with CLSR set and at half of it otherwise;
+// with one-cycle instructions it gets speedPerLine of them per line instead,
+// 5/2 as many with CLSR set.
+static void FxAccrue (void)
+{
+	int32	elapsed = CPU.Cycles - SuperFX.cycleBase;
+
+	SuperFX.cycleBase = CPU.Cycles;
+
+	if (!FxRunning())
 	{
-		FxEmulate(((Memory.FillRAM[0x3000 + GSU_CLSR] & 1) ? (SuperFX.speedPerLine * 5 / 2) : SuperFX.speedPerLine) * Settings.SuperFXClockMultiplier / 100);
+		SuperFX.cycles = 0;
+		SuperFX.cycleRemainder = 0;
+		return;
+	}
+
+	if (elapsed <= 0)
+		return;
 
-		uint16 GSUStatus = Memory.FillRAM[0x3000 + GSU_SFR] | (Memory.FillRAM[0x3000 + GSU_SFR + 1] << 8);
-		if ((GSUStatus & (FLG_G | FLG_IRQ)) == FLG_IRQ)
-			CPU.IRQExternal = TRUE;
+	uint32	divisor = FxCycleDivisor();
+	uint64	scaled  = (uint64) elapsed * Settings.SuperFXClockMultiplier;
+
+	if (!Settings.SuperFXCycleCosts)
+		scaled *= SuperFX.speedPerLine;
+
+	scaled += SuperFX.cycleRemainder;
+
+	SuperFX.cycles += (int32) (scaled / divisor);
+	SuperFX.cycleRemainder = (uint32) (scaled % divisor);
+}
+
+// Runs the GSU up to the current CPU cycle, if it is owed at least minimum cycles
+static void FxSync (int32 minimum)
+{
+	FxAccrue();
+
+	if (SuperFX.cycles <= 0 || SuperFX.cycles < minimum)
+		return;
+
+	SuperFX.cycles = FxEmulate(SuperFX.cycles);
+
+	if (!FxRunning())
+	{
+		SuperFX.cycles = 0;
+		SuperFX.cycleRemainder = 0;
+	}
+
+	uint16 GSUStatus = Memory.FillRAM[0x3000 + GSU_SFR] | (Memory.FillRAM[0x3000 + GSU_SFR + 1] << 8);
+	if ((GSUStatus & (FLG_G | FLG_IRQ)) == FLG_IRQ)
+		CPU.IRQExternal = TRUE;
+}
+
+// Called at the end of every line, just before CPU.Cycles is wound back by H_Max.
+// The CPU reads GSU RAM and ROM through the memory map without a catch-up, so
+// the GSU is never left more than this line behind.
+void S9xSuperFXExec (void)
+{
+	FxSync(1);
+
+	SuperFX.cycleBase -= Timings.H_Max;
+}
+
+// The credit the GSU is owed is saved in vCounter and vInstCount, which only
+// matter inside fx_run, so a loaded state resumes exactly where it was saved
+void S9xSuperFXPreSaveState (void)
+{
+	FxAccrue();
+	GSU.vCounter = (uint32) SuperFX.cycles;
+	GSU.vInstCount = SuperFX.cycleRemainder;
+}
+
+void S9xSuperFXPostLoadState (void)
+{
+	SuperFX.cycles = (int32) GSU.vCounter;
+	SuperFX.cycleRemainder = GSU.vInstCount;
+	SuperFX.cycleBase = CPU.Cycles;
+
+	// Older states hold an instruction counter here
+	if (SuperFX.cycles > FX_MAX_SAVED_CYCLES || SuperFX.cycles < -FX_MAX_SAVED_CYCLES || SuperFX.cycleRemainder >= FxCycleDivisor())
+	{
+		SuperFX.cycles = 0;
+		SuperFX.cycleRemainder = 0;
 	}
 }
 
@@ -364,10 +458,11 @@ static bool8 fx_checkStartAddress (void)
 	return (TRUE);
 }
 
-// Execute until the next stop instruction
-static uint32 FxEmulate (uint32 nInstructions)
+// Execute until the next stop instruction or until nCycles GSU cycles are used up,
+// and return the cycles left over
+static int32 FxEmulate (int32 nCycles)
 {
-	uint32	vCount;
+	int32	vLeft;
 
 	// Read registers and initialize GSU session
 	fx_readRegisterSpace();
@@ -390,165 +485,74 @@ static uint32 FxEmulate (uint32 nInstructions)
 
 	/*
 	if (GSU.bBreakPoint)
-		vCount = fx_run_to_breakpoint(nInstructions);
+		vLeft = fx_run_to_breakpoint(nCycles);
 	else
 	*/
-	vCount = fx_run(nInstructions);
+	vLeft = fx_run(nCycles);
+
+	S9xPerfAdd(PERF_SUPERFX_INSTRUCTIONS, GSU.vInstCount);
 
 	// Store GSU registers
 	fx_writeRegisterSpace();
 
-	// Check for error code
-	if (GSU.vErrorCode)
-		return (GSU.vErrorCode);
-	else
-		return (vCount);
+	return (vLeft);
 }
 
-void fx_computeScreenPointers (void)
+// Offset of each 8x8 character from the screen base, for heights 128, 160, 192
+// and 256 (OBJ mode) and 2, 4 and 8 bits per pixel, indexed [row * 32 + column]
+static uint16	fx_ScreenLayout[4][3][32 * 32];
+
+// Offset of the start of a character row (apvScreen[i] - pvScreenBase)
+static uint32 fx_screenRowOffset (uint32 n, uint32 depth, uint32 i)
 {
-	if (GSU.vMode != GSU.vPrevMode || GSU.vPrevScreenHeight != GSU.vScreenHeight || GSU.vSCBRDirty)
-	{
-		GSU.vSCBRDirty = FALSE;
+	if (n == 3)
+		return ((((i & 0x10) << 9) + ((i & 0xf) << 8)) << depth);
 
-		// Make a list of pointers to the start of each screen column
-		switch (GSU.vScreenHeight)
-		{
-			case 128:
-				switch (GSU.vMode)
-				{
-					case 0:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + (i << 4);
-							GSU.x[i] = i <<  8;
-						}
-
-						break;
-
-					case 1:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + (i << 5);
-							GSU.x[i] = i <<  9;
-						}
-
-						break;
-
-					case 2:
-					case 3:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + (i << 6);
-							GSU.x[i] = i << 10;
-						}
-
-						break;
-				}
+	return (i << (4 + depth));
+}
 
-				break;
+// Offset of a character column (x[i])
+static uint32 fx_screenColumnOffset (uint32 n, uint32 depth, uint32 i)
+{
+	if (n == 3)
+		return ((((i & 0x10) << 8) + ((i & 0xf) << 4)) << depth);
 
-			case 160:
-				switch (GSU.vMode)
-				{
-					case 0:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + (i << 4);
-							GSU.x[i] = (i <<  8) + (i << 6);
-						}
-
-						break;
-
-					case 1:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + (i << 5);
-							GSU.x[i] = (i <<  9) + (i << 7);
-						}
-
-						break;
-
-					case 2:
-					case 3:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + (i << 6);
-							GSU.x[i] = (i << 10) + (i << 8);
-						}
-
-						break;
-				}
+	// one column is height / 8 characters of 16 << depth bytes
+	return ((i * (128 + n * 32) * 2) << depth);
+}
 
-				break;
+static void fx_buildScreenLayouts (void)
+{
+	for (uint32 n = 0; n < 4; n++)
+	{
+		for (uint32 depth = 0; depth < 3; depth++)
+		{
+			for (uint32 row = 0; row < 32; row++)
+			{
+				for (uint32 column = 0; column < 32; column++)
+					fx_ScreenLayout[n][depth][(row << 5) | column] = fx_screenRowOffset(n, depth, row) + fx_screenColumnOffset(n, depth, column);
+			}
+		}
+	}
+}
 
-			case 192:
-				switch (GSU.vMode)
-				{
-					case 0:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + (i << 4);
-							GSU.x[i] = (i <<  8) + (i << 7);
-						}
-
-						break;
-
-					case 1:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + (i << 5);
-							GSU.x[i] = (i <<  9) + (i << 8);
-						}
-
-						break;
-
-					case 2:
-					case 3:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + (i << 6);
-							GSU.x[i] = (i << 10) + (i << 9);
-						}
-
-						break;
-				}
+void fx_computeScreenPointers (void)
+{
+	uint32	n = (GSU.vScreenHeight == 256) ? 3 : (GSU.vScreenHeight - 128) / 32;
+	uint32	depth = (GSU.vMode == 3) ? 2 : GSU.vMode;
 
-				break;
+	// PLOT and RPIX look characters up here; switching layouts rebuilds nothing
+	GSU.pvScreenLayout = fx_ScreenLayout[n][depth];
 
-			case 256:
-				switch (GSU.vMode)
-				{
-					case 0:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + ((i & 0x10) <<  9) + ((i & 0xf) <<  8);
-							GSU.x[i] = ((i & 0x10) <<  8) + ((i & 0xf) << 4);
-						}
-
-						break;
-
-					case 1:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + ((i & 0x10) << 10) + ((i & 0xf) <<  9);
-							GSU.x[i] = ((i & 0x10) <<  9) + ((i & 0xf) << 5);
-						}
-
-						break;
-
-					case 2:
-					case 3:
-						for (int i = 0; i < 32; i++)
-						{
-							GSU.apvScreen[i] = GSU.pvScreenBase + ((i & 0x10) << 11) + ((i & 0xf) << 10);
-							GSU.x[i] = ((i & 0x10) << 10) + ((i & 0xf) << 6);
-						}
-
-						break;
-				}
+	// apvScreen and x are still kept for savestates
+	if (GSU.vMode != GSU.vPrevMode || GSU.vPrevScreenHeight != GSU.vScreenHeight || GSU.vSCBRDirty)
+	{
+		GSU.vSCBRDirty = FALSE;
 
-				break;
+		for (int i = 0; i < 32; i++)
+		{
+			GSU.apvScreen[i] = GSU.pvScreenBase + fx_screenRowOffset(n, depth, i);
+			GSU.x[i] = fx_screenColumnOffset(n, depth, i);
 		}
 
 		GSU.vPrevMode = GSU.vMode;
@@ -556,7 +560,6 @@ void fx_computeScreenPointers (void)
 	}
 }
 
-// Write access to the cache
 static void FxCacheWriteAccess (uint16 vAddress)
 {
 	/*
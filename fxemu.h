@@ -19,8 +19,10 @@ struct FxInfo_s
 	uint8	*pvRam;			// Pointer to GSU-RAM
 	uint32	nRomBanks;		// Number of 32kb-banks in Cart-ROM
 	uint8	*pvRom;			// Pointer to Cart-ROM
-	uint32	speedPerLine;
-	bool8	oneLineDone;
+	uint32	speedPerLine;	// Instructions per line when every instruction costs one cycle
+	int32	cycles;			// GSU clock cycles the GSU is owed, negative after it overran
+	int32	cycleBase;		// CPU.Cycles when cycles was last brought up to date
+	uint32	cycleRemainder;	// Master cycles * SuperFXClockMultiplier not yet turned into GSU cycles
 };
 
 extern struct FxInfo_s	SuperFX;
@@ -28,10 +30,13 @@ extern struct FxInfo_s	SuperFX;
 void S9xInitSuperFX (void);
 void S9xResetSuperFX (void);
 void S9xSuperFXExec (void);
+void S9xSuperFXPreSaveState (void);
+void S9xSuperFXPostLoadState (void);
 void S9xSetSuperFX (uint8, uint16);
 uint8 S9xGetSuperFX (uint16);
 void fx_flushCache (void);
 void fx_computeScreenPointers (void);
-uint32 fx_run (uint32);
+void fx_buildCycleTables (void);
+int32 fx_run (int32);
 
 #endif
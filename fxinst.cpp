@@ -26,8 +26,6 @@
 static void fx_stop (void)
 {
 	CF(G);
-	GSU.vCounter = 0;
-	GSU.vInstCount = GSU.vCounter;
 
 	// Check if we need to generate an IRQ
 	if (!(GSU.pvRegisters[GSU_CFGR] & 0x80))
@@ -728,7 +726,7 @@ static void fx_plot_2bit (void)
 	else
 		c = (uint8) GSU.vColorReg;
 
-	a = GSU.apvScreen[y >> 3] + GSU.x[x >> 3] + ((y & 7) << 1);
+	a = GSU.pvScreenBase + GSU.pvScreenLayout[((y >> 3) << 5) | (x >> 3)] + ((y & 7) << 1);
 	v = 128 >> (x & 7);
 
 	if (c & 0x01)
@@ -758,7 +756,7 @@ static void fx_rpix_2bit (void)
 		return;
 #endif
 
-	a = GSU.apvScreen[y >> 3] + GSU.x[x >> 3] + ((y & 7) << 1);
+	a = GSU.pvScreenBase + GSU.pvScreenLayout[((y >> 3) << 5) | (x >> 3)] + ((y & 7) << 1);
 	v = 128 >> (x & 7);
 
 	DREG = 0;
@@ -792,7 +790,7 @@ static void fx_plot_4bit (void)
 	else
 		c = (uint8) GSU.vColorReg;
 
-	a = GSU.apvScreen[y >> 3] + GSU.x[x >> 3] + ((y & 7) << 1);
+	a = GSU.pvScreenBase + GSU.pvScreenLayout[((y >> 3) << 5) | (x >> 3)] + ((y & 7) << 1);
 	v = 128 >> (x & 7);
 
 	if (c & 0x01)
@@ -832,7 +830,7 @@ static void fx_rpix_4bit (void)
 		return;
 #endif
 
-	a = GSU.apvScreen[y >> 3] + GSU.x[x >> 3] + ((y & 7) << 1);
+	a = GSU.pvScreenBase + GSU.pvScreenLayout[((y >> 3) << 5) | (x >> 3)] + ((y & 7) << 1);
 	v = 128 >> (x & 7);
 
 	DREG = 0;
@@ -870,7 +868,7 @@ static void fx_plot_8bit (void)
 	if (!(GSU.vPlotOptionReg & 0x01) && !c)
 		return;
 
-	a = GSU.apvScreen[y >> 3] + GSU.x[x >> 3] + ((y & 7) << 1);
+	a = GSU.pvScreenBase + GSU.pvScreenLayout[((y >> 3) << 5) | (x >> 3)] + ((y & 7) << 1);
 	v = 128 >> (x & 7);
 
 	if (c & 0x01)
@@ -930,7 +928,7 @@ static void fx_rpix_8bit (void)
 		return;
 #endif
 
-	a = GSU.apvScreen[y >> 3] + GSU.x[x >> 3] + ((y & 7) << 1);
+	a = GSU.pvScreenBase + GSU.pvScreenLayout[((y >> 3) << 5) | (x >> 3)] + ((y & 7) << 1);
 	v = 128 >> (x & 7);
 
 	DREG = 0;
@@ -3961,20 +3959,104 @@ static void fx_sm_r15 (void)
 	FX_SM(15);
 }
 
+// Approximate GSU clock cycles of each instruction beyond its opcode fetch,
+// indexed [CLSR][CFGR MS0][ALT | opcode]: the number of operand bytes it
+// fetches in the top two bits and the cycles it spends on memory and the
+// multiplier in the rest. Fetches cost 1 cycle from the cache and 3 (5 with
+// CLSR set) from ROM or RAM. Without Settings.SuperFXCycleCosts every
+// instruction costs one cycle: fx_FlatCycleTable is all zeros and so is
+// every fetch after the first.
+
+static uint8	fx_CycleTable[2][2][0x400];
+static uint8	fx_FlatCycleTable[0x400];
+
+void fx_buildCycleTables (void)
+{
+	for (uint32 clsr = 0; clsr < 2; clsr++)
+	{
+		uint32	mem = clsr ? 5 : 3;
+
+		for (uint32 ms0 = 0; ms0 < 2; ms0++)
+		{
+			for (uint32 i = 0; i < 0x400; i++)
+			{
+				uint32	alt = i >> 8, op = i & 0xff;
+				uint32	operands = 0, extra = 0;
+
+				if (op >= 0x05 && op <= 0x0f)		// branches
+					operands = 1;
+				else
+				if (op >= 0x30 && op <= 0x3b)		// stw, stb
+					extra = 1;
+				else
+				if (op >= 0x40 && op <= 0x4b)		// ldw, ldb
+					extra = mem;
+				else
+				if (op == 0x4c)						// plot, rpix
+					extra = (alt & 1) ? mem * 2 : 1;
+				else
+				if (op >= 0x80 && op <= 0x8f)		// mult, umult
+					extra = ms0 ? 0 : 1;
+				else
+				if (op == 0x90)						// sbk
+					extra = 1;
+				else
+				if (op == 0x9f)						// fmult, lmult
+					extra = ms0 ? 3 : 7;
+				else
+				if (op >= 0xa0 && op <= 0xaf)		// ibt, lms, sms
+				{
+					operands = 1;
+					extra = (alt == 1) ? mem : (alt == 2) ? 1 : 0;
+				}
+				else
+				if (op == 0xdf || op == 0xef)		// getc, getb
+					extra = 1;
+				else
+				if (op >= 0xf0)						// iwt, lm, sm
+				{
+					operands = 2;
+					extra = (alt == 1) ? mem : (alt == 2) ? 1 : 0;
+				}
+
+				fx_CycleTable[clsr][ms0][i] = (uint8) ((operands << 6) | extra);
+			}
+		}
+	}
+}
+
 // GSU executions functions
 
-uint32 fx_run (uint32 nInstructions)
+// Runs until STOP or until nCycles GSU cycles are used up, counting the
+// instructions in vInstCount, and returns the cycles left over
+int32 fx_run (int32 nCycles)
 {
-	GSU.vCounter = nInstructions;
-	while (TF(G) && (GSU.vCounter-- > 0))
+	const uint8	*cost = fx_CycleTable[CLSR & 1][(CFGR & 0x20) ? 1 : 0];
+	int32		fetch = (CLSR & 1) ? 5 : 3;
+
+	if (!Settings.SuperFXCycleCosts)
+	{
+		cost = fx_FlatCycleTable;
+		fetch = 1;
+	}
+
+	GSU.vInstCount = 0;
+	while (TF(G) && nCycles > 0)
+	{
+		uint32	c = cost[(GSU.vStatusReg & 0x300) | PIPE];
+		int32	f = (GSU.bCacheActive && USEX16(R15 - CBR) < 512) ? 1 : fetch;
+
+		nCycles -= f * (1 + (c >> 6)) + (c & 0x3f);
+		GSU.vInstCount++;
 		FX_STEP;
+	}
 #if 0
 #ifndef FX_ADDRESS_CHECK
 	GSU.vPipeAdr = USEX16(R15 - 1) | (USEX8(GSU.vPrgBankReg) << 16);
 #endif
 #endif
 
-	return (nInstructions - GSU.vInstCount);
+	return (nCycles);
 }
 
 /*
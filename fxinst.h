@@ -178,6 +178,7 @@ struct FxRegs_s
 	uint8	*pvScreenBase;
 	uint8	*apvScreen[32];				// Pointer to each of the 32 screen colums
 	int32	x[32];
+	uint16	*pvScreenLayout;			// Offset of each character from pvScreenBase, [row * 32 + column]
 	uint32	vScreenHeight;				// 128, 160, 192 or 256 (could be overriden by cmode)
 	uint32	vScreenRealHeight;			// 128, 160, 192 or 256
 	uint32	vPrevScreenHeight;
@@ -16,6 +16,7 @@
 #include "seta.h"
 #include "bsx.h"
 #include "msu1.h"
+#include "coverage.h"
 
 #define addCyclesInMemoryAccess \
 	if (!CPU.InDMAorHDMA) \
@@ -149,6 +150,14 @@ inline uint8 S9xGetByte (uint32 Address)
 			addCyclesInMemoryAccess;
 			return (byte);
 
+		case CMemory::MAP_COVERAGE:
+			return (S9xCoverageGetByte(Address));
+
+	#ifdef DEBUGGER
+		case CMemory::MAP_WATCH:
+			return (S9xWatchpointGetByte(Address));
+	#endif
+
 		case CMemory::MAP_NONE:
 		default:
 			byte = OpenBus;
@@ -309,6 +318,14 @@ inline uint16 S9xGetWord (uint32 Address, enum s9xwrap_t w = WRAP_NONE)
 			addCyclesInMemoryAccess;
 			return (word);
 
+		case CMemory::MAP_COVERAGE:
+			return (S9xCoverageGetWord(Address));
+
+	#ifdef DEBUGGER
+		case CMemory::MAP_WATCH:
+			return (S9xWatchpointGetWord(Address));
+	#endif
+
 		case CMemory::MAP_NONE:
 		default:
 			word = OpenBus | (OpenBus << 8);
@@ -325,7 +342,9 @@ inline void S9xSetByte (uint8 Byte, uint32 Address)
 
 	if (SetAddress >= (uint8 *) CMemory::MAP_LAST)
 	{
-		*(SetAddress + (Address & 0xffff)) = Byte;
+		SetAddress += Address & 0xffff;
+		*SetAddress = Byte;
+		S9xMarkDirtyPage(SetAddress);
 		addCyclesInMemoryAccess;
 		return;
 	}
@@ -348,7 +367,9 @@ inline void S9xSetByte (uint8 Byte, uint32 Address)
 		case CMemory::MAP_LOROM_SRAM:
 			if (Memory.SRAMMask)
 			{
-				*(Memory.SRAM + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Memory.SRAMMask)) = Byte;
+				uint8	*p = Memory.SRAM + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Memory.SRAMMask);
+				*p = Byte;
+				S9xMarkDirtyPage(p);
 				CPU.SRAMModified = TRUE;
 			}
 
@@ -358,7 +379,9 @@ inline void S9xSetByte (uint8 Byte, uint32 Address)
 		case CMemory::MAP_LOROM_SRAM_B:
 			if (Multi.sramMaskB)
 			{
-				*(Multi.sramB + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Multi.sramMaskB)) = Byte;
+				uint8	*p = Multi.sramB + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Multi.sramMaskB);
+				*p = Byte;
+				S9xMarkDirtyPage(p);
 				CPU.SRAMModified = TRUE;
 			}
 
@@ -368,7 +391,9 @@ inline void S9xSetByte (uint8 Byte, uint32 Address)
 		case CMemory::MAP_HIROM_SRAM:
 			if (Memory.SRAMMask)
 			{
-				*(Memory.SRAM + (((Address & 0x7fff) - 0x6000 + ((Address & 0x1f0000) >> 3)) & Memory.SRAMMask)) = Byte;
+				uint8	*p = Memory.SRAM + (((Address & 0x7fff) - 0x6000 + ((Address & 0x1f0000) >> 3)) & Memory.SRAMMask);
+				*p = Byte;
+				S9xMarkDirtyPage(p);
 				CPU.SRAMModified = TRUE;
 			}
 
@@ -416,6 +441,12 @@ inline void S9xSetByte (uint8 Byte, uint32 Address)
 			addCyclesInMemoryAccess;
 			return;
 
+	#ifdef DEBUGGER
+		case CMemory::MAP_WATCH:
+			S9xWatchpointSetByte(Byte, Address);
+			return;
+	#endif
+
 		case CMemory::MAP_NONE:
 		default:
 			addCyclesInMemoryAccess;
@@ -465,7 +496,10 @@ inline void S9xSetWord (uint16 Word, uint32 Address, enum s9xwrap_t w = WRAP_NON
 
 	if (SetAddress >= (uint8 *) CMemory::MAP_LAST)
 	{
-		WRITE_WORD(SetAddress + (Address & 0xffff), Word);
+		// never crosses a page, see the MEMMAP_MASK check above
+		SetAddress += Address & 0xffff;
+		WRITE_WORD(SetAddress, Word);
+		S9xMarkDirtyPage(SetAddress);
 		addCyclesInMemoryAccess_x2;
 		return;
 	}
@@ -528,6 +562,7 @@ inline void S9xSetWord (uint16 Word, uint32 Address, enum s9xwrap_t w = WRAP_NON
 					*(Memory.SRAM + (((((Address + 1) & 0xff0000) >> 1) | ((Address + 1) & 0x7fff)) & Memory.SRAMMask)) = Word >> 8;
 				}
 
+				S9xMarkDirtyPage(Memory.SRAM + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Memory.SRAMMask));
 				CPU.SRAMModified = TRUE;
 			}
 
@@ -545,6 +580,7 @@ inline void S9xSetWord (uint16 Word, uint32 Address, enum s9xwrap_t w = WRAP_NON
 					*(Multi.sramB + (((((Address + 1) & 0xff0000) >> 1) | ((Address + 1) & 0x7fff)) & Multi.sramMaskB)) = Word >> 8;
 				}
 
+				S9xMarkDirtyPage(Multi.sramB + ((((Address & 0xff0000) >> 1) | (Address & 0x7fff)) & Multi.sramMaskB));
 				CPU.SRAMModified = TRUE;
 			}
 
@@ -562,6 +598,7 @@ inline void S9xSetWord (uint16 Word, uint32 Address, enum s9xwrap_t w = WRAP_NON
 					*(Memory.SRAM + ((((Address + 1) & 0x7fff) - 0x6000 + (((Address + 1) & 0x1f0000) >> 3)) & Memory.SRAMMask)) = Word >> 8;
 				}
 
+				S9xMarkDirtyPage(Memory.SRAM + (((Address & 0x7fff) - 0x6000 + ((Address & 0x1f0000) >> 3)) & Memory.SRAMMask));
 				CPU.SRAMModified = TRUE;
 			}
 
@@ -687,6 +724,12 @@ inline void S9xSetWord (uint16 Word, uint32 Address, enum s9xwrap_t w = WRAP_NON
 				return;
 			}
 
+	#ifdef DEBUGGER
+		case CMemory::MAP_WATCH:
+			S9xWatchpointSetWord(Word, Address, o);
+			return;
+	#endif
+
 		case CMemory::MAP_NONE:
 		default:
 			addCyclesInMemoryAccess_x2;
@@ -757,6 +800,10 @@ inline void S9xSetPCBase (uint32 Address)
 			CPU.PCBase = S9xGetBasePointerBSX(Address);
 			return;
 
+		case CMemory::MAP_COVERAGE:
+			CPU.PCBase = Coverage.Map[(Address & 0xffffff) >> MEMMAP_SHIFT];
+			return;
+
 		case CMemory::MAP_NONE:
 		default:
 			CPU.PCBase = NULL;
@@ -803,6 +850,9 @@ inline uint8 * S9xGetBasePointer (uint32 Address)
 		case CMemory::MAP_OBC_RAM:
 			return (S9xGetBasePointerOBC1(Address & 0xffff));
 
+		case CMemory::MAP_COVERAGE:
+			return (Coverage.Map[(Address & 0xffffff) >> MEMMAP_SHIFT]);
+
 		case CMemory::MAP_NONE:
 		default:
 			return (NULL);
@@ -848,6 +898,9 @@ inline uint8 * S9xGetMemPointer (uint32 Address)
 		case CMemory::MAP_OBC_RAM:
 			return (S9xGetMemPointerOBC1(Address & 0xffff));
 
+		case CMemory::MAP_COVERAGE:
+			return (Coverage.Map[(Address & 0xffffff) >> MEMMAP_SHIFT] + (Address & 0xffff));
+
 		case CMemory::MAP_NONE:
 		default:
 			return (NULL);
@@ -4,6 +4,7 @@
    For further information, consult the LICENSE file in the root directory.
 \*****************************************************************************/
 
+#include <algorithm>
 #include "snes9x.h"
 #include "ppu.h"
 #include "tile.h"
@@ -13,6 +14,7 @@
 #include "movie.h"
 #include "screenshot.h"
 #include "display.h"
+#include "perfcounters.h"
 
 extern struct SCheatData		Cheat;
 extern struct SLineData			LineData[240];
@@ -28,6 +30,7 @@ static void DisplayTime (void);
 static void DisplayFrameRate (void);
 static void DisplayPressedKeys (void);
 static void DisplayWatchedAddresses (void);
+static void DisplayPerfCounters (void);
 static void DisplayStringFromBottom (const char *, int, int, bool);
 static void DrawBackground (int, uint8, uint8);
 static void DrawBackgroundMosaic (int, uint8, uint8);
@@ -145,8 +148,16 @@ void S9xGraphicsScreenResize (void)
 
 void S9xBuildDirectColourMaps (void)
 {
+	static int	built = -1;
+
 	IPPU.XB = mul_brightness[PPU.Brightness];
 
+	// the maps depend on nothing but the brightness, which state loads rarely change
+	if (PPU.Brightness == built)
+		return;
+
+	built = PPU.Brightness;
+
 	for (uint32 p = 0; p < 8; p++)
 		for (uint32 c = 0; c < 256; c++)
 			DirectColourMaps[p][c] = BUILD_PIXEL(IPPU.XB[((c & 7) << 2) | ((p & 1) << 1)], IPPU.XB[((c & 0x38) >> 1) | (p & 2)], IPPU.XB[((c & 0xc0) >> 3) | (p & 4)]);
@@ -154,6 +165,9 @@ void S9xBuildDirectColourMaps (void)
 
 void S9xStartScreenRefresh (void)
 {
+	// the port has presented, mixed and polled for the previous frame by now
+	S9xPerfEndFrame();
+
 	if (GFX.DoInterlace)
 		GFX.DoInterlace--;
 
@@ -435,6 +449,8 @@ static inline void RenderScreen (bool8 sub)
 
 void S9xUpdateScreen (void)
 {
+	S9xPerfAdd(PERF_PARTIAL_RENDERS, 1);
+
 	if (IPPU.OBJChanged || IPPU.InterlaceOBJ)
 		SetupOBJ();
 
@@ -1735,6 +1751,50 @@ void S9xSetInfoString (const char *string)
 static const int font_width = 8;
 static const int font_height = 10;
 
+// One run of opaque pixels in a glyph row, mask is 1 for the foreground and 0 for the outline
+struct GlyphRun
+{
+	uint8	row;
+	uint8	x;
+	uint8	len;
+	uint8	mask[font_width];
+};
+
+// Opaque pixels of one screen row of a layout, pixels indexes OSDLayout::pixels
+struct OSDSpan
+{
+	int		x;
+	int		y;
+	int		len;
+	uint32	pixels;
+};
+
+// A string rasterised at its screen position, kept until the text or the screen layout changes
+struct OSDLayout
+{
+	std::string				text;
+	int						linesFromBottom;
+	int						pixelsFromLeft;
+	bool					allowWrap;
+	int						type;
+	int						width;
+	int						height;
+	uint16					color;
+	bool8					overscan;
+	bool8					pressedKeys;
+	uint32					id;
+	uint32					used;
+	std::vector<OSDSpan>	spans;
+	std::vector<uint16>		pixels;
+};
+
+#define OSD_CACHE_SIZE	32
+
+static std::vector<GlyphRun>	GlyphRuns[2][224];	// [monospace][c - 32]
+static OSDLayout				OSDCache[OSD_CACHE_SIZE];
+static uint32					OSDLayoutCount = 0, OSDClock = 0;
+static std::vector<uint32>		OSDActive, OSDDrawn;
+
 static inline int CharWidth(uint8 c)
 {
 	return font_width - var8x10font_kern[c - 32][0] - var8x10font_kern[c - 32][1];
@@ -1750,53 +1810,141 @@ static int StringWidth(const char* str)
 
 	for (int i = 0; i < length; i++)
 	{
-		pixcount += (CharWidth(str[i]) - 1);
+		pixcount += (CharWidth((uint8) str[i] < 32 ? ' ' : str[i]) - 1);
 	}
 
 	return pixcount;
 }
 
-static void VariableDisplayChar(int x, int y, uint8 c, bool monospace = false, int overlap = 0)
+static void RasteriseGlyphs (void)
 {
-	int cindex = c - 32;
-	int crow = cindex >> 4;
-	int ccol = cindex & 15;
-	int cwidth = font_width - (monospace ? 0 : (var8x10font_kern[cindex][0] + var8x10font_kern[cindex][1]));
+	for (int monospace = 0; monospace < 2; monospace++)
+	{
+		for (int cindex = 0; cindex < 224; cindex++)
+		{
+			int	line = (cindex >> 4) * font_height;
+			int	offset = (cindex & 15) * font_width + (monospace ? 0 : var8x10font_kern[cindex][0]);
+			int	cwidth = font_width - (monospace ? 0 : (var8x10font_kern[cindex][0] + var8x10font_kern[cindex][1]));
+
+			std::vector<GlyphRun>	&runs = GlyphRuns[monospace][cindex];
+
+			for (int h = 0; h < font_height; h++)
+			{
+				const char	*row = var8x10font[line + h] + offset;
 
-	int	line = crow * font_height;
-	int	offset = ccol * font_width + (monospace ? 0 : var8x10font_kern[cindex][0]);
-	int scale = IPPU.RenderedScreenWidth / SNES_WIDTH;
+				for (int w = 0; w < cwidth; )
+				{
+					if (row[w] != '#' && row[w] != '.')
+					{
+						w++;
+						continue;
+					}
 
-	uint16* s = GFX.Screen + y * GFX.RealPPL + x * scale;
+					GlyphRun	run;
+					run.row = h;
+					run.x = w;
+					run.len = 0;
 
-	for (int h = 0; h < font_height; h++, line++, s += GFX.RealPPL - cwidth * scale)
+					for (; w < cwidth && (row[w] == '#' || row[w] == '.'); w++)
+						run.mask[run.len++] = (row[w] == '#');
+
+					runs.push_back(run);
+				}
+			}
+		}
+	}
+}
+
+struct GlyphPlacement
+{
+	int		x;
+	int		y;
+	uint8	c;
+};
+
+// Paints the glyphs in order, so later ones overlap earlier ones as before, and keeps the
+// opaque pixels of each screen row as spans that are blitted with one memcpy each
+static void RasteriseLayout (OSDLayout &layout, const std::vector<GlyphPlacement> &glyphs, bool monospace, int scale)
+{
+	static std::vector<int32>	canvas;
+
+	if (glyphs.empty())
+		return;
+
+	int	top = layout.height, bottom = 0;
+
+	for (size_t g = 0; g < glyphs.size(); g++)
+	{
+		top = std::min(top, glyphs[g].y);
+		bottom = std::max(bottom, glyphs[g].y + font_height);
+	}
+
+	top = std::max(top, 0);
+	bottom = std::min(bottom, layout.height);
+	if (top >= bottom)
+		return;
+
+	canvas.assign((bottom - top) * layout.width, -1);
+
+	for (size_t g = 0; g < glyphs.size(); g++)
 	{
-		for (int w = 0; w < cwidth; w++, s++)
+		const std::vector<GlyphRun>	&runs = GlyphRuns[monospace][glyphs[g].c - 32];
+
+		for (size_t r = 0; r < runs.size(); r++)
 		{
-			if (var8x10font[line][offset + w] == '#')
-				*s = Settings.DisplayColor;
-			else if (var8x10font[line][offset + w] == '.')
-				*s = 0x0000;
-			//            else if (!monospace && w >= overlap)
-			//                *s = (*s & 0xf7de) >> 1;
-			//                *s = (*s & 0xe79c) >> 2;
-
-			if (scale > 1)
+			const GlyphRun	&run = runs[r];
+			int				y = glyphs[g].y + run.row;
+			int				start = (glyphs[g].x + run.x) * scale;
+
+			if (y < top || y >= bottom)
+				continue;
+
+			for (int px = std::max(start, 0); px < std::min(start + run.len * scale, layout.width); px++)
+				canvas[(y - top) * layout.width + px] = run.mask[(px - start) / scale] ? layout.color : 0x0000;
+		}
+	}
+
+	for (int y = top; y < bottom; y++)
+	{
+		const int32	*row = &canvas[(y - top) * layout.width];
+
+		for (int x = 0; x < layout.width; )
+		{
+			if (row[x] < 0)
 			{
-				s[1] = s[0];
-				s++;
+				x++;
+				continue;
 			}
+
+			OSDSpan	span;
+			span.x = x;
+			span.y = y;
+			span.pixels = layout.pixels.size();
+
+			for (; x < layout.width && row[x] >= 0; x++)
+				layout.pixels.push_back((uint16) row[x]);
+
+			span.len = x - span.x;
+			layout.spans.push_back(span);
 		}
 	}
 }
 
-void S9xVariableDisplayString(const char* string, int linesFromBottom,	int pixelsFromLeft, bool allowWrap, int type)
+static void BuildLayout (OSDLayout &layout)
 {
-	if (GFX.ScreenBuffer.empty() || IPPU.RenderedScreenWidth == 0)
-		return;
+	const char	*string = layout.text.c_str();
+	int			linesFromBottom = layout.linesFromBottom;
+	int			pixelsFromLeft = layout.pixelsFromLeft;
+	bool		allowWrap = layout.allowWrap;
+
+	layout.spans.clear();
+	layout.pixels.clear();
+
+	if (GlyphRuns[0][0].empty())
+		RasteriseGlyphs();
 
 	bool monospace = true;
-	if (type == S9X_NO_INFO)
+	if (layout.type == S9X_NO_INFO)
 	{
 		if (linesFromBottom <= 0)
 			linesFromBottom = 1;
@@ -1816,27 +1964,28 @@ void S9xVariableDisplayString(const char* string, int linesFromBottom,	int pixel
 	}
 
 	int min_lines = 1;
-	std::string msg(string);
-	for (auto& c : msg)
-		if (c == '\n')
+	for (const char *p = string; *p; p++)
+		if (*p == '\n')
 			min_lines++;
 	if (min_lines > linesFromBottom)
 		linesFromBottom = min_lines;
 
 	int dst_x = pixelsFromLeft;
-	int dst_y = IPPU.RenderedScreenHeight - (font_height)*linesFromBottom;
-	int len = strlen(string);
+	int dst_y = layout.height - (font_height)*linesFromBottom;
+	int len = layout.text.length();
+	int scale = layout.width / SNES_WIDTH;
 
-	if (IPPU.RenderedScreenHeight % 224 && !Settings.ShowOverscan)
+	if (layout.height % 224 && !Settings.ShowOverscan)
 		dst_y -= 8;
 	else if (Settings.ShowOverscan)
 		dst_y += 8;
 
-	int overlap = 0;
+	std::vector<GlyphPlacement> glyphs;
 
 	for (int i = 0; i < len; i++)
 	{
-		int cindex = (uint8)string[i] - 32;
+		uint8 c = (uint8) string[i] < 32 ? ' ' : (uint8) string[i];
+		int cindex = c - 32;
 		int char_width = font_width - (monospace ? 1 : (var8x10font_kern[cindex][0] + var8x10font_kern[cindex][1]));
 
 		if (dst_x + char_width > SNES_WIDTH || string[i] == '\n')
@@ -1845,21 +1994,137 @@ void S9xVariableDisplayString(const char* string, int linesFromBottom,	int pixel
 				break;
 
 			linesFromBottom--;
-			dst_y = IPPU.RenderedScreenHeight - font_height * linesFromBottom;
+			dst_y = layout.height - font_height * linesFromBottom;
 			dst_x = pixelsFromLeft;
 
-			if (dst_y >= IPPU.RenderedScreenHeight)
+			if (dst_y >= layout.height)
 				break;
 		}
 
 		if (string[i] == '\n')
 			continue;
 
-		VariableDisplayChar(dst_x, dst_y, string[i], monospace, overlap);
+		GlyphPlacement glyph = { dst_x, dst_y, c };
+		glyphs.push_back(glyph);
 
 		dst_x += char_width - 1;
-		overlap = 1;
 	}
+
+	RasteriseLayout(layout, glyphs, monospace, scale);
+}
+
+// Returns the cached layout for this string, rasterising it only if the text or the screen changed
+static OSDLayout *GetLayout (const char *string, int linesFromBottom, int pixelsFromLeft, bool allowWrap, int type)
+{
+	static int	hint = 0;
+	OSDLayout	*lru = NULL, *oldest = &OSDCache[0];
+
+	OSDClock++;
+
+	// strings are usually requested in the same order every frame, so start after the last hit
+	for (int n = 0; n < OSD_CACHE_SIZE; n++)
+	{
+		int			i = (hint + n) % OSD_CACHE_SIZE;
+		OSDLayout	&l = OSDCache[i];
+
+		if (l.id &&
+			l.linesFromBottom == linesFromBottom &&
+			l.pixelsFromLeft == pixelsFromLeft &&
+			l.allowWrap == allowWrap &&
+			l.type == type &&
+			l.width == IPPU.RenderedScreenWidth &&
+			l.height == IPPU.RenderedScreenHeight &&
+			l.color == Settings.DisplayColor &&
+			l.overscan == Settings.ShowOverscan &&
+			l.pressedKeys == Settings.DisplayPressedKeys &&
+			l.text == string)
+		{
+			l.used = OSDClock;
+			hint = i + 1;
+			return (&l);
+		}
+
+		if (l.used < oldest->used)
+			oldest = &l;
+
+		// layouts already queued for the overlay this frame must survive until it is drawn
+		if ((!lru || l.used < lru->used) && std::find(OSDActive.begin(), OSDActive.end(), l.id) == OSDActive.end())
+			lru = &l;
+	}
+
+	if (!lru)
+	{
+		lru = oldest;
+		OSDActive.erase(std::find(OSDActive.begin(), OSDActive.end(), lru->id));
+	}
+
+	lru->text = string;
+	lru->linesFromBottom = linesFromBottom;
+	lru->pixelsFromLeft = pixelsFromLeft;
+	lru->allowWrap = allowWrap;
+	lru->type = type;
+	lru->width = IPPU.RenderedScreenWidth;
+	lru->height = IPPU.RenderedScreenHeight;
+	lru->color = Settings.DisplayColor;
+	lru->overscan = Settings.ShowOverscan;
+	lru->pressedKeys = Settings.DisplayPressedKeys;
+	lru->id = ++OSDLayoutCount;
+	lru->used = OSDClock;
+	hint = (lru - OSDCache) + 1;
+
+	BuildLayout(*lru);
+
+	return (lru);
+}
+
+static void BlitLayout (const OSDLayout &layout, uint16 *screen, int ppl)
+{
+	const uint16	*pixels = layout.pixels.data();
+
+	for (size_t i = 0; i < layout.spans.size(); i++)
+	{
+		const OSDSpan	&span = layout.spans[i];
+		memcpy(screen + span.y * ppl + span.x, pixels + span.pixels, span.len * sizeof(uint16));
+	}
+}
+
+void S9xVariableDisplayString(const char* string, int linesFromBottom,	int pixelsFromLeft, bool allowWrap, int type)
+{
+	if (GFX.ScreenBuffer.empty() || IPPU.RenderedScreenWidth == 0)
+		return;
+
+	OSDLayout	*layout = GetLayout(string, linesFromBottom, pixelsFromLeft, allowWrap, type);
+
+	if (!Settings.MessagesAsOverlay)
+	{
+		BlitLayout(*layout, GFX.Screen, GFX.RealPPL);
+		return;
+	}
+
+	if (std::find(OSDActive.begin(), OSDActive.end(), layout->id) == OSDActive.end())
+		OSDActive.push_back(layout->id);
+}
+
+bool8 S9xOSDOverlayChanged (void)
+{
+	return (OSDActive != OSDDrawn);
+}
+
+void S9xDrawOSDOverlay (uint16 *screen, int ppl)
+{
+	for (size_t i = 0; i < OSDActive.size(); i++)
+	{
+		for (int j = 0; j < OSD_CACHE_SIZE; j++)
+		{
+			if (OSDCache[j].id == OSDActive[i])
+			{
+				BlitLayout(OSDCache[j], screen, ppl);
+				break;
+			}
+		}
+	}
+
+	OSDDrawn = OSDActive;
 }
 
 static void DisplayStringFromBottom(const char* string, int linesFromBottom, int pixelsFromLeft, bool allowWrap)
@@ -2087,8 +2352,41 @@ static void DisplayWatchedAddresses (void)
 	}
 }
 
+// Last frame's counters in the top left corner; time stages are in microseconds
+static void DisplayPerfCounters (void)
+{
+	char	string[64];
+	int		line = IPPU.RenderedScreenHeight / font_height;
+
+	sprintf(string, "CPU %u DMA %u HDMA %u",
+			S9xPerfCounterValue(PERF_CPU_INSTRUCTIONS), S9xPerfCounterValue(PERF_DMA_BYTES), S9xPerfCounterValue(PERF_HDMA_LINES));
+	S9xDisplayString(string, line--, 1, false);
+
+	sprintf(string, "Redraw %u Tiles %u",
+			S9xPerfCounterValue(PERF_PARTIAL_RENDERS), S9xPerfCounterValue(PERF_TILE_MISSES));
+	S9xDisplayString(string, line--, 1, false);
+
+	sprintf(string, "APU %u Idle %u",
+			S9xPerfCounterValue(PERF_APU_CATCHUPS), S9xPerfCounterValue(PERF_SMP_SKIPPED_CYCLES));
+	S9xDisplayString(string, line--, 1, false);
+
+	if (Settings.SA1 || Settings.SuperFX)
+	{
+		sprintf(string, "SA1 %u GSU %u",
+				S9xPerfCounterValue(PERF_SA1_CYCLES), S9xPerfCounterValue(PERF_SUPERFX_INSTRUCTIONS));
+		S9xDisplayString(string, line--, 1, false);
+	}
+
+	sprintf(string, "Buf %u Frm %u Vid %u Aud %u In %u",
+			S9xPerfCounterValue(PERF_AUDIO_BUFFER), S9xPerfCounterValue(PERF_TIME_FRAME), S9xPerfCounterValue(PERF_TIME_VIDEO),
+			S9xPerfCounterValue(PERF_TIME_AUDIO), S9xPerfCounterValue(PERF_TIME_INPUT));
+	S9xDisplayString(string, line, 1, false);
+}
+
 void S9xDisplayMessages (uint16 *screen, int ppl, int width, int height, int scale)
 {
+	OSDActive.clear();
+
 	if (Settings.DisplayTime)
 		DisplayTime();
 
@@ -2098,6 +2396,9 @@ void S9xDisplayMessages (uint16 *screen, int ppl, int width, int height, int sca
 	if (Settings.DisplayWatchedAddresses)
 		DisplayWatchedAddresses();
 
+	if (Settings.DisplayPerfCounters)
+		DisplayPerfCounters();
+
 	if (Settings.DisplayPressedKeys)
 		DisplayPressedKeys();
 
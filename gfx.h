@@ -209,6 +209,11 @@ void S9xDisplayChar (uint16 *, uint8);
 void S9xGraphicsScreenResize (void);
 // called automatically unless Settings.AutoDisplayMessages is false
 void S9xDisplayMessages (uint16 *, int, int, int, int);
+// with Settings.MessagesAsOverlay the messages are kept out of GFX.Screen and the port draws them
+// itself, e.g. into a transparent layer that only needs redrawing when S9xOSDOverlayChanged() is TRUE;
+// only ports that draw the overlay may set it, so it is not read from the shared [Display] section
+bool8 S9xOSDOverlayChanged (void);
+void S9xDrawOSDOverlay (uint16 *, int);
 
 // external port interface which must be implemented or initialised for each port
 bool8 S9xGraphicsInit (void);
@@ -14,6 +14,7 @@
 #include "display.h"
 #include "conffile.h"
 #include "crosshairs.h"
+#include "perfcounters.h"
 #include <stdio.h>
 #include <vector>
 #include <string>
@@ -68,6 +69,10 @@ char retro_save_directory[4096];
 
 retro_log_printf_t log_cb = NULL;
 static retro_video_refresh_t video_cb = NULL;
+static bool can_dupe = false;
+static bool frame_presented = false;
+static unsigned last_frame_width = SNES_WIDTH, last_frame_height = SNES_HEIGHT;
+static size_t last_frame_pitch = 0;
 static retro_audio_sample_t audio_cb = NULL;
 static retro_audio_sample_batch_t audio_batch_cb = NULL;
 static retro_input_poll_t poll_cb = NULL;
@@ -77,6 +82,10 @@ static snes_ntsc_t *snes_ntsc = NULL;
 static int blargg_filter = 0;
 static uint16 *ntsc_screen_buffer, *snes_ntsc_buffer;
 
+// Only used when MSU-1 audio has to be mixed in; sized for the 32 ms APU buffer
+#define AUDIO_BUFFER_SAMPLES (32040 * 32 * 2 / 1000)
+static std::vector<int16_t> audio_buffer;
+
 const int MAX_SNES_WIDTH_NTSC = ((SNES_NTSC_OUT_WIDTH(256) + 3) / 4) * 4;
 
 static bool show_lightgun_settings = true;
@@ -158,6 +167,7 @@ static retro_environment_t environ_cb;
 static overscan_mode crop_overscan_mode = OVERSCAN_CROP_ON; // default to crop
 static aspect_mode aspect_ratio_mode = ASPECT_RATIO_4_3; // default to 4:3
 static bool rom_loaded = false;
+static size_t serialize_size = 0;
 
 enum lightgun_mode
 {
@@ -756,15 +766,30 @@ void S9xSyncSpeed() {
         return;
     }
 
-    static std::vector<int16_t> audio_buffer;
+    uint64 start = S9xPerfTimestamp();
+    int16 *samples;
+    int avail = S9xPeekSamples(&samples);
 
-    size_t avail = S9xGetSampleCount();
+    // The DSP runs at the rate we report, so unless MSU-1 audio has to be
+    // mixed in, the frame's samples go to the frontend straight from the
+    // core's buffer
+    if (avail >= 0)
+    {
+        if (avail)
+            audio_batch_cb(samples, avail >> 1);
+        S9xReleaseSamples(avail);
+    }
+    else
+    {
+        avail = S9xGetSampleCount();
 
-    if (audio_buffer.size() < avail)
-        audio_buffer.resize(avail);
+        if (audio_buffer.size() < (size_t)avail)
+            audio_buffer.resize(avail);
 
-    S9xMixSamples((uint8*)&audio_buffer[0], avail);
-    audio_batch_cb(&audio_buffer[0], avail >> 1);
+        S9xMixSamples((uint8*)&audio_buffer[0], avail);
+        audio_batch_cb(&audio_buffer[0], avail >> 1);
+    }
+    S9xPerfAddTime(PERF_TIME_AUDIO, start);
 }
 
 void retro_get_system_info(struct retro_system_info *info)
@@ -1099,6 +1124,7 @@ static bool8 is_SufamiTurbo_Cart (const uint8 *data, uint32 size)
 bool retro_load_game(const struct retro_game_info *game)
 {
     init_descriptors();
+    serialize_size = 0;
 
     update_variables();
 
@@ -1199,6 +1225,7 @@ bool retro_load_game_special(unsigned game_type, const struct retro_game_info *i
 
     init_descriptors();
     rom_loaded = false;
+    serialize_size = 0;
 
     update_variables();
     switch (game_type)
@@ -1292,7 +1319,9 @@ bool retro_load_game_special(unsigned game_type, const struct retro_game_info *i
 }
 
 void retro_unload_game(void)
-{}
+{
+    serialize_size = 0;
+}
 
 static void map_buttons();
 
@@ -1344,6 +1373,8 @@ void retro_init(void)
     Settings.AutoDisplayMessages = TRUE;
     Settings.InitialInfoStringTimeout = 120;
     Settings.HDMATimingHack = 100;
+    Settings.SkipSMPIdleLoops = TRUE;
+    Settings.FastDSP = TRUE;
     Settings.BlockInvalidVRAMAccessMaster = TRUE;
     Settings.SeparateEchoBuffer = FALSE;
     Settings.CartAName[0] = 0;
@@ -1364,6 +1395,7 @@ void retro_init(void)
     }
 
     S9xInitSound(32);
+    audio_buffer.resize(AUDIO_BUFFER_SAMPLES);
 
     S9xSetSoundMute(FALSE);
     S9xSetSamplesAvailableCallback(NULL, NULL);
@@ -1382,6 +1414,9 @@ void retro_init(void)
     S9xUnmapAllControls();
     map_buttons();
     check_system_specs();
+
+    if (!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &can_dupe))
+        can_dupe = false;
 }
 
 #define MAP_BUTTON(id, name) S9xMapButton((id), S9xGetCommandT((name)), false)
@@ -1843,9 +1878,21 @@ void retro_run()
         S9xSetSoundMute(false);
     }
 
+    uint64 start = S9xPerfTimestamp();
     poll_cb();
     report_buttons();
+    S9xPerfAddTime(PERF_TIME_INPUT, start);
+
+    start = S9xPerfTimestamp();
+    frame_presented = false;
     S9xMainLoop();
+    S9xPerfAddTime(PERF_TIME_FRAME, start);
+
+    // skipped frames (video disabled by the frontend) still owe it a frame; rendered
+    // frames are presented even when unchanged, as spotting that would need a compare
+    // against a kept copy of the last frame (PPU writes alone don't flag every change)
+    if (!frame_presented && can_dupe)
+        video_cb(NULL, last_frame_width, last_frame_height, last_frame_pitch);
 }
 
 void retro_deinit()
@@ -1934,7 +1981,13 @@ size_t retro_get_memory_size(unsigned type)
 
 size_t retro_serialize_size()
 {
-    return rom_loaded ? S9xFreezeSize() : 0;
+    // Which blocks a state holds only depends on the loaded game, and fast
+    // states have the same layout, so the size is worked out once per game
+    // instead of running the whole serialization on every call
+    if (rom_loaded && !serialize_size)
+        serialize_size = S9xFreezeSize();
+
+    return rom_loaded ? serialize_size : 0;
 }
 
 bool retro_serialize(void *data, size_t size)
@@ -1946,6 +1999,8 @@ bool retro_serialize(void *data, size_t size)
     {
         Settings.FastSavestates = 0 != (result & 4);
     }
+    if (size < retro_serialize_size())
+        return false;
     if (S9xFreezeGameMem((uint8_t*)data,size) == FALSE)
         return false;
 
@@ -1967,11 +2022,48 @@ bool retro_unserialize(const void* data, size_t size)
     return true;
 }
 
+// Rows of GFX.Screen that may still hold pixels from an earlier, taller frame.
+// Frames shorter than the output height are padded with these rows, so they
+// are cleared once when the picture shrinks instead of on every frame.
+static int screen_rows_used = MAX_SNES_HEIGHT;
+
+static void blank_rows_from(int row)
+{
+    if (screen_rows_used > row)
+    {
+        memset(GFX.Screen + (GFX.Pitch >> 1) * row, 0, GFX.Pitch * (screen_rows_used - row));
+        screen_rows_used = row;
+    }
+}
+
+// Asks the frontend for a buffer to put the filtered frame in, so it doesn't
+// have to copy it again. Only used for output the core writes anyway (NTSC
+// filter, hires blending); GFX.Screen itself is still handed over as it is.
+static bool get_frame_buffer(unsigned width, unsigned height, uint16 **data, size_t *pitch)
+{
+    struct retro_framebuffer fb = {0};
+
+    fb.width = width;
+    fb.height = height;
+    fb.access_flags = RETRO_MEMORY_ACCESS_WRITE;
+
+    if (!environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, &fb) || !fb.data || fb.format != RETRO_PIXEL_FORMAT_RGB565)
+        return false;
+
+    *data = (uint16 *) fb.data;
+    *pitch = fb.pitch;
+    return true;
+}
+
 bool8 S9xDeinitUpdate(int width, int height)
 {
+    uint64 start = S9xPerfTimestamp();
     static int burst_phase = 0;
     int overscan_offset = 0;
 
+    if (height > screen_rows_used)
+        screen_rows_used = height;
+
     if (crop_overscan_mode == OVERSCAN_CROP_ON)
     {
         if (height > SNES_HEIGHT * 2)
@@ -1992,7 +2084,7 @@ bool8 S9xDeinitUpdate(int width, int height)
             if (height < SNES_HEIGHT_EXTENDED * 2)
             {
                 overscan_offset = -16;
-                memset(GFX.Screen + (GFX.Pitch >> 1) * height,0,GFX.Pitch * ((SNES_HEIGHT_EXTENDED << 1) - height));
+                blank_rows_from(height);
             }
             height = SNES_HEIGHT_EXTENDED * 2;
         }
@@ -2001,34 +2093,54 @@ bool8 S9xDeinitUpdate(int width, int height)
             if (height < SNES_HEIGHT_EXTENDED)
             {
                 overscan_offset = -8;
-                memset(GFX.Screen + (GFX.Pitch >> 1) * height,0,GFX.Pitch * (SNES_HEIGHT_EXTENDED - height));
+                blank_rows_from(height);
             }
             height = SNES_HEIGHT_EXTENDED;
         }
     }
 
+    uint16 *screen = GFX.Screen + (int)(GFX.Pitch >> 1) * overscan_offset;
+    uint16 *out = screen;
+    int out_width = width;
+    size_t out_pitch = GFX.Pitch;
 
     if (blargg_filter)
     {
         burst_phase = (burst_phase + 1) % 3;
 
+        out_width = SNES_NTSC_OUT_WIDTH(256);
+        if (!get_frame_buffer(out_width, height, &out, &out_pitch))
+        {
+            out = snes_ntsc_buffer;
+            out_pitch = MAX_SNES_WIDTH_NTSC * 2;
+        }
+
+        // the phase steps once per row, keep it lined up with row 0 of the frame
+        int phase = ((burst_phase + overscan_offset) % 3 + 3) % 3;
+
         if (width == 512)
-            snes_ntsc_blit_hires(snes_ntsc, GFX.Screen, GFX.Pitch / 2, burst_phase, width, height, snes_ntsc_buffer, MAX_SNES_WIDTH_NTSC * 2);
+            snes_ntsc_blit_hires(snes_ntsc, screen, GFX.Pitch / 2, phase, width, height, out, out_pitch);
         else
-            snes_ntsc_blit(snes_ntsc, GFX.Screen, GFX.Pitch / 2, burst_phase, width, height, snes_ntsc_buffer, MAX_SNES_WIDTH_NTSC * 2);
-
-        video_cb(snes_ntsc_buffer + ((int)(MAX_SNES_WIDTH_NTSC) * overscan_offset), SNES_NTSC_OUT_WIDTH(256), height, MAX_SNES_WIDTH_NTSC * 2);
+            snes_ntsc_blit(snes_ntsc, screen, GFX.Pitch / 2, phase, width, height, out, out_pitch);
     }
     else if (width == MAX_SNES_WIDTH && hires_blend)
     {
         #define AVERAGE_565(el0, el1) (((el0) & (el1)) + ((((el0) ^ (el1)) & 0xF7DE) >> 1))
 
+        if (hires_blend == 2)
+            out_width = width >> 1;
+        if (!get_frame_buffer(out_width, height, &out, &out_pitch))
+        {
+            out = screen;
+            out_pitch = GFX.Pitch;
+        }
+
         if (hires_blend == 1) /* Blur method */
         {
             for (int y = 0; y < height; y++)
             {
-                uint16 *input = (uint16 *) ((uint8 *) GFX.Screen + y * GFX.Pitch);
-                uint16 *output = (uint16 *) ((uint8 *) GFX.Screen + y * GFX.Pitch);
+                uint16 *input = (uint16 *) ((uint8 *) screen + y * GFX.Pitch);
+                uint16 *output = (uint16 *) ((uint8 *) out + y * out_pitch);
                 uint16 l, r;
 
                 l = 0;
@@ -2048,8 +2160,8 @@ bool8 S9xDeinitUpdate(int width, int height)
         {
             for (int y = 0; y < height; y++)
             {
-                uint16 *input = (uint16 *) ((uint8 *) GFX.Screen + y * GFX.Pitch);
-                uint16 *output = (uint16 *) ((uint8 *) GFX.Screen + y * GFX.Pitch);
+                uint16 *input = (uint16 *) ((uint8 *) screen + y * GFX.Pitch);
+                uint16 *output = (uint16 *) ((uint8 *) out + y * out_pitch);
                 uint16 l, r;
 
                 for (int x = 0; x < (width >> 1); x++)
@@ -2059,17 +2171,17 @@ bool8 S9xDeinitUpdate(int width, int height)
                     *output++ = AVERAGE_565 (l, r);
                 }
             }
-
-            width >>= 1;
         }
-
-        video_cb(GFX.Screen + ((int)(GFX.Pitch >> 1) * overscan_offset), width, height, GFX.Pitch);
-    }
-    else
-    {
-        video_cb(GFX.Screen + ((int)(GFX.Pitch >> 1) * overscan_offset), width, height, GFX.Pitch);
     }
 
+    video_cb(out, out_width, height, out_pitch);
+
+    frame_presented = true;
+    last_frame_width = out_width;
+    last_frame_height = height;
+    last_frame_pitch = out_pitch;
+
+    S9xPerfAddTime(PERF_TIME_VIDEO, start);
     return TRUE;
 }
 
@@ -17,16 +17,14 @@
 #include "memmap.h"
 
 
-bool8 LoadZip (const char *zipname, uint32 *TotalFileSize, uint8 *buffer)
+// Opens a zip file and picks the entry LoadZip loads: the largest file (under
+// MAX_ROM_SIZE), a file with extension .1 or a file named program.rom
+static unzFile OpenROMEntry (const char *zipname, char *filename)
 {
-	*TotalFileSize = 0;
-
 	unzFile	file = unzOpen(zipname);
 	if (file == NULL)
-		return (FALSE);
+		return (NULL);
 
-	// find largest file in zip file (under MAX_ROM_SIZE) or a file with extension .1, or a file named program.rom
-	char	filename[132];
 	uint32	filesize = 0;
 	int		port = unzGoToFirstFile(file);
 
@@ -73,9 +71,23 @@ bool8 LoadZip (const char *zipname, uint32 *TotalFileSize, uint8 *buffer)
 	{
 		if (unzClose(file) != UNZ_OK)
 			assert(FALSE);
-		return (FALSE);
+		return (NULL);
 	}
 
+	return (file);
+}
+
+bool8 LoadZip (const char *zipname, uint32 *TotalFileSize, uint8 *buffer)
+{
+	*TotalFileSize = 0;
+
+	char	filename[132];
+	unzFile	file = OpenROMEntry(zipname, filename);
+	if (file == NULL)
+		return (FALSE);
+
+	unz_file_info	info;
+
 	// find extension
 	char	tmp[2] = { 0, 0 };
 	char	*ext = strrchr(filename, '.');
@@ -159,4 +171,28 @@ bool8 LoadZip (const char *zipname, uint32 *TotalFileSize, uint8 *buffer)
 	return (TRUE);
 }
 
+// The entry LoadZip would load (only its first part for split ROMs), as a
+// stream that inflates no further than it is read
+Stream * OpenZipROMStream (const char *zipname, uint32 *size, uint32 *crc)
+{
+	char	filename[132];
+	unzFile	file = OpenROMEntry(zipname, filename);
+	if (file == NULL)
+		return (NULL);
+
+	unz_file_info	info;
+
+	if (unzLocateFile(file, filename, 0) != UNZ_OK ||
+		unzGetCurrentFileInfo(file, &info, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK)
+	{
+		unzClose(file);
+		return (NULL);
+	}
+
+	*size = info.uncompressed_size;
+	*crc  = info.crc;
+
+	return (new unzStream(file));
+}
+
 #endif
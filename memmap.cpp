@@ -9,6 +9,11 @@
 #include <sstream>
 #include <numeric>
 #include <assert.h>
+#ifndef __LIBRETRO__
+#define ROM_PROBE_THREADS
+#include <thread>
+#include <atomic>
+#endif
 
 #ifdef UNZIP_SUPPORT
 #  ifdef SYSTEM_ZIP
@@ -37,6 +42,7 @@
 #include "display.h"
 #include "sha256.h"
 #include "snapshot.h"
+#include "perfcounters.h"
 
 #ifndef SET_UI_COLOR
 #define SET_UI_COLOR(r, g, b) ;
@@ -773,15 +779,15 @@ static const uint32	crc32Table[256] =
 static void S9xDeinterleaveType1 (int, uint8 *);
 static void S9xDeinterleaveType2 (int, uint8 *);
 static void S9xDeinterleaveGD24 (int, uint8 *);
-static bool8 allASCII (uint8 *, int);
+static bool8 allASCII (const uint8 *, int);
 static bool8 is_SufamiTurbo_BIOS (const uint8 *, uint32);
 static bool8 is_SufamiTurbo_Cart (const uint8 *, uint32);
 static bool8 is_BSCart_BIOS (const uint8 *, uint32);
 static bool8 is_BSCartSA1_BIOS(const uint8 *, uint32);
 static bool8 is_GNEXT_Add_On (const uint8 *, uint32);
-static uint32 caCRC32 (uint8 *, uint32, uint32 crc32 = 0xffffffff);
+static uint32 caCRC32 (const uint8 *, uint32, uint32 crc32 = 0xffffffff);
+static const char * RegionName (uint8);
 static bool8 ReadUPSPatch (Stream *, long, int32 &);
-static long ReadInt (Stream *, unsigned);
 static bool8 ReadIPSPatch (Stream *, long, int32 &);
 #ifdef UNZIP_SUPPORT
 static int unzFindExtension (unzFile &, const char *, bool restart = TRUE, bool print = TRUE, bool allowExact = FALSE);
@@ -984,6 +990,8 @@ void CMemory::Deinit (void)
 {
 	ROM = NULL;
 
+	S9xDeinitBSX();
+
 	for (int t = 0; t < 7; t++)
 	{
 		if (IPPU.TileCache[t])
@@ -1002,7 +1010,7 @@ void CMemory::Deinit (void)
 
 // file management and ROM detection
 
-static bool8 allASCII (uint8 *b, int size)
+static bool8 allASCII (const uint8 *b, int size)
 {
 	for (int i = 0; i < size; i++)
 	{
@@ -1072,10 +1080,12 @@ static bool8 is_GNEXT_Add_On (const uint8 *data, uint32 size)
 		return (FALSE);
 }
 
-int CMemory::ScoreHiROM (bool8 skip_header, int32 romoff)
+// The scores only look at the image through these, so S9xProbeROM can use them on its own buffer
+
+static int ScoreHiROMData (const uint8 *rom, uint32 CalculatedSize)
 {
-	uint8	*buf = ROM + 0xff00 + romoff + (skip_header ? 0x200 : 0);
-	int		score = 0;
+	const uint8	*buf = rom + 0xff00;
+	int			score = 0;
 
 	// Check for extended HiROM expansion used in Mother 2 Deluxe et al.
 	// Looks for size byte 13 (8MB) and an actual ROM size greater than 4MB
@@ -1126,10 +1136,10 @@ int CMemory::ScoreHiROM (bool8 skip_header, int32 romoff)
 	return (score);
 }
 
-int CMemory::ScoreLoROM (bool8 skip_header, int32 romoff)
+static int ScoreLoROMData (const uint8 *rom, uint32 CalculatedSize)
 {
-	uint8	*buf = ROM + 0x7f00 + romoff + (skip_header ? 0x200 : 0);
-	int		score = 0;
+	const uint8	*buf = rom + 0x7f00;
+	int			score = 0;
 
 	if (!(buf[0xd5] & 0x1))
 		score += 3;
@@ -1172,11 +1182,10 @@ int CMemory::ScoreLoROM (bool8 skip_header, int32 romoff)
 	return (score);
 }
 
-int CMemory::First512BytesCountZeroes() const
+static int CountZeroes (const uint8 *buf, int size)
 {
-	const uint8 *buf = ROM;
 	int zeroCount = 0;
-	for (int i = 0; i < 512; i++)
+	for (int i = 0; i < size; i++)
 	{
 		if (buf[i] == 0)
 		{
@@ -1186,6 +1195,21 @@ int CMemory::First512BytesCountZeroes() const
 	return zeroCount;
 }
 
+int CMemory::ScoreHiROM (bool8 skip_header, int32 romoff)
+{
+	return (ScoreHiROMData(ROM + romoff + (skip_header ? 0x200 : 0), CalculatedSize));
+}
+
+int CMemory::ScoreLoROM (bool8 skip_header, int32 romoff)
+{
+	return (ScoreLoROMData(ROM + romoff + (skip_header ? 0x200 : 0), CalculatedSize));
+}
+
+int CMemory::First512BytesCountZeroes() const
+{
+	return (CountZeroes(ROM, 512));
+}
+
 uint32 CMemory::HeaderRemove (uint32 size, uint8 *buf)
 {
 	uint32	calc_size = (size / 0x2000) * 0x2000;
@@ -1214,6 +1238,137 @@ uint32 CMemory::HeaderRemove (uint32 size, uint8 *buf)
 	return (size);
 }
 
+// Recently loaded ROM files as FileLoader leaves them in the buffer (inflated,
+// copier headers removed), so switching back to a game skips the file read
+// and the unzip/JMA decompression. Entries are keyed by path, device, inode,
+// size and modification time (to the nanosecond where the platform keeps it,
+// so a rewrite within the same second is still noticed) plus the header
+// settings HeaderRemove looks at; patches
+// and mapping detection still run on every load, as they depend on files
+// and settings that may have changed in between.
+
+struct SROMCacheEntry
+{
+	std::string			filename;
+	int64				file_size;
+	int64				file_time;
+	int64				file_time_nsec;
+	uint64				file_device;
+	uint64				file_inode;
+	bool8				force_header;
+	bool8				force_no_header;
+
+	std::vector<uint8>	data;				// everything FileLoader wrote to the buffer
+	uint32				size;				// what FileLoader returned
+	int					header_count;
+	uint8				nsrt_header[32];
+	uint32				last_used;
+};
+
+static std::vector<SROMCacheEntry>	ROMCache;
+static size_t						ROMCacheLimit = ROM_CACHE_DEFAULT_SIZE;
+static uint32						ROMCacheClock = 0;
+
+static bool ROMCacheKey (const char *filename, SROMCacheEntry &key)
+{
+	struct stat	st;
+
+	if (!ROMCacheLimit || stat(filename, &st) != 0)
+		return (false);
+
+	key.filename        = filename;
+	key.file_size       = (int64) st.st_size;
+	key.file_time       = (int64) st.st_mtime;
+#if defined(_WIN32)
+	key.file_time_nsec  = 0;
+#elif defined(__APPLE__)
+	key.file_time_nsec  = (int64) st.st_mtimespec.tv_nsec;
+#else
+	key.file_time_nsec  = (int64) st.st_mtim.tv_nsec;
+#endif
+	key.file_device     = (uint64) st.st_dev;
+	key.file_inode      = (uint64) st.st_ino;
+	key.force_header    = Settings.ForceHeader;
+	key.force_no_header = Settings.ForceNoHeader;
+
+	return (true);
+}
+
+static SROMCacheEntry * ROMCacheFind (const SROMCacheEntry &key)
+{
+	for (size_t i = 0; i < ROMCache.size(); i++)
+	{
+		SROMCacheEntry	&entry = ROMCache[i];
+
+		if (entry.file_size == key.file_size && entry.file_time == key.file_time &&
+			entry.file_time_nsec == key.file_time_nsec &&
+			entry.file_device == key.file_device && entry.file_inode == key.file_inode &&
+			entry.force_header == key.force_header && entry.force_no_header == key.force_no_header &&
+			entry.filename == key.filename)
+		{
+			entry.last_used = ++ROMCacheClock;
+			return (&entry);
+		}
+	}
+
+	return (NULL);
+}
+
+static void ROMCacheTrim (size_t limit)
+{
+	size_t	total = 0;
+
+	for (size_t i = 0; i < ROMCache.size(); i++)
+		total += ROMCache[i].data.size();
+
+	while (total > limit && !ROMCache.empty())
+	{
+		size_t	oldest = 0;
+
+		for (size_t i = 1; i < ROMCache.size(); i++)
+		{
+			if (ROMCache[i].last_used < ROMCache[oldest].last_used)
+				oldest = i;
+		}
+
+		total -= ROMCache[oldest].data.size();
+		ROMCache.erase(ROMCache.begin() + oldest);
+	}
+}
+
+static void ROMCacheStore (SROMCacheEntry &key, const uint8 *buffer, uint32 extent, uint32 size, int header_count, const uint8 *nsrt_header)
+{
+	if (extent > ROMCacheLimit)
+		return;
+
+	// a changed file replaces its old entry
+	for (size_t i = 0; i < ROMCache.size(); i++)
+	{
+		if (ROMCache[i].filename == key.filename)
+		{
+			ROMCache.erase(ROMCache.begin() + i);
+			break;
+		}
+	}
+
+	ROMCacheTrim(ROMCacheLimit - extent);
+
+	key.data.assign(buffer, buffer + extent);
+	key.size = size;
+	key.header_count = header_count;
+	memcpy(key.nsrt_header, nsrt_header, sizeof(key.nsrt_header));
+	key.last_used = ++ROMCacheClock;
+
+	ROMCache.push_back(SROMCacheEntry());
+	std::swap(ROMCache.back(), key);
+}
+
+void S9xSetROMCacheSize (size_t bytes)
+{
+	ROMCacheLimit = bytes;
+	ROMCacheTrim(bytes);
+}
+
 uint32 CMemory::FileLoader (uint8 *buffer, const char *filename, uint32 maxsize)
 {
 	// <- ROM size without header
@@ -1224,6 +1379,42 @@ uint32 CMemory::FileLoader (uint8 *buffer, const char *filename, uint32 maxsize)
 	memset(NSRTHeader, 0, sizeof(NSRTHeader));
 	HeaderCount = 0;
 
+	SROMCacheEntry	key;
+	bool			cacheable = ROMCacheKey(filename, key);
+	SROMCacheEntry	*cached = cacheable ? ROMCacheFind(key) : NULL;
+
+	if (cached && cached->data.size() <= maxsize + 0x200)
+	{
+		memcpy(buffer, &cached->data[0], cached->data.size());
+		memcpy(NSRTHeader, cached->nsrt_header, sizeof(NSRTHeader));
+		HeaderCount = cached->header_count;
+		ROMFilename = filename;
+		totalSize = cached->size;
+	}
+	else
+	{
+		totalSize = FileLoaderInt(buffer, filename, maxsize);
+
+		// HeaderRemove leaves a copy of the last 512 bytes behind the data for
+		// each header it strips; keep those too so a hit fills the buffer the same
+		if (cacheable && totalSize)
+			ROMCacheStore(key, buffer, min(totalSize + 512 * HeaderCount, maxsize + 0x200), totalSize, HeaderCount, NSRTHeader);
+	}
+
+	if (HeaderCount == 0)
+		S9xMessage(S9X_INFO, S9X_HEADERS_INFO, "No ROM file header found.");
+	else if (HeaderCount == 1)
+		S9xMessage(S9X_INFO, S9X_HEADERS_INFO, "Found ROM file header (and ignored it).");
+	else
+		S9xMessage(S9X_INFO, S9X_HEADERS_INFO, "Found multiple ROM file headers (and ignored them).");
+
+	return (totalSize);
+}
+
+uint32 CMemory::FileLoaderInt (uint8 *buffer, const char *filename, uint32 maxsize)
+{
+	uint32	totalSize = 0;
+
 	auto path = splitpath(filename);
 
 	int	nFormat = FILE_DEFAULT;
@@ -1291,13 +1482,6 @@ uint32 CMemory::FileLoader (uint8 *buffer, const char *filename, uint32 maxsize)
 		}
 	}
 
-	if (HeaderCount == 0)
-		S9xMessage(S9X_INFO, S9X_HEADERS_INFO, "No ROM file header found.");
-	else if (HeaderCount == 1)
-		S9xMessage(S9X_INFO, S9X_HEADERS_INFO, "Found ROM file header (and ignored it).");
-	else
-		S9xMessage(S9X_INFO, S9X_HEADERS_INFO, "Found multiple ROM file headers (and ignored them).");
-
 	return ((uint32) totalSize);
 }
 
@@ -1347,6 +1531,387 @@ bool8 CMemory::LoadROM (const char *filename)
     return TRUE;
 }
 
+// ROM probing for library indexing. LoadROM's header, mapping and interleave
+// decisions are repeated on windows of the image instead of a loaded ROM, so
+// a zipped ROM is only inflated as far as its headers, and nothing global is
+// touched.
+
+#define PROBE_CHUNK_SIZE	0x10000
+
+struct SProbeImage
+{
+	Stream				*stream;
+	std::vector<uint8>	data;			// the start of the file, zero-padded past what was read
+	uint32				length;			// bytes read from the stream
+	bool				at_end;
+
+	uint32				header;			// copier header size
+	uint32				fill_size;		// size of the ROM without the header
+	uint32				size;			// CalculatedSize
+	uint32				interleave[2];	// sizes passed to S9xDeinterleaveType1, in order; 0 if not done
+	bool				smallfirst;		// the swapped ExHiROM fix-up
+};
+
+// Makes data hold the first `size` bytes of the file
+static void ProbeRead (SProbeImage &image, uint32 size)
+{
+	if (size > image.data.size())
+		image.data.resize(size, 0);
+
+	while (!image.at_end && image.length < size)
+	{
+		size_t	want = min((uint32) PROBE_CHUNK_SIZE, size - image.length);
+		size_t	n = image.stream->read(&image.data[image.length], want);
+
+		if (n == 0 || n > want)
+			image.at_end = true;
+		else
+			image.length += n;
+	}
+}
+
+static void ProbeReadAll (SProbeImage &image)
+{
+	// FileLoader reads no more than this either
+	const uint32	limit = CMemory::MAX_ROM_SIZE + 0x200;
+
+	while (!image.at_end && image.length < limit)
+		ProbeRead(image, min(limit, max((uint32) image.data.size() * 2, (uint32) PROBE_CHUNK_SIZE)));
+}
+
+// Where byte `offset` of the ROM, as LoadROMInt would leave it, is in the file
+static uint32 ProbeSourceOffset (const SProbeImage &image, uint32 offset)
+{
+	if (image.smallfirst)
+		offset = (offset < 0x400000) ? offset + image.size - 0x400000 : offset - 0x400000;
+
+	for (int i = 1; i >= 0; i--)
+	{
+		// S9xDeinterleaveType1 puts 32K block i + n at 2i and block i at 2i + 1
+		uint32	nblocks = image.interleave[i] >> 16;
+		uint32	block = offset >> 15;
+
+		if (block < nblocks * 2)
+			offset = (((block & 1) ? block >> 1 : (block >> 1) + nblocks) << 15) | (offset & 0x7fff);
+	}
+
+	return (image.header + offset);
+}
+
+// Fills the parts of ROM[base, base + 0x10000) that the scores and the header
+// parser look at; the rest of view is zero
+static void ProbeView (SProbeImage &image, uint32 base, uint8 *view)
+{
+	memset(view, 0, 0x10000);
+
+	for (uint32 window = 0x7f00; window < 0x10000; window += 0x8000)
+	{
+		uint32	src = ProbeSourceOffset(image, base + window);
+
+		ProbeRead(image, src + 0x100);
+		memcpy(view + window, &image.data[src], 0x100);
+	}
+}
+
+// LoadROMInt from the header removal on. Returns false where LoadROM would
+// start over with ForceNotInterleaved.
+static bool ProbeLayout (SProbeImage &image, bool allow_interleave, bool &hirom, bool &bigfirst)
+{
+	std::vector<uint8>	view(0x10000);
+	uint8				*rom = &view[0];
+	bool				extended = false;
+
+	image.interleave[0] = image.interleave[1] = 0;
+	image.smallfirst = false;
+	bigfirst = false;
+
+	ProbeView(image, 0, rom);
+
+	if (image.size > 0x400000 &&
+		(rom[0x7fd5] + (rom[0x7fd6] << 8)) != 0x1320 && // exclude SuperFX
+		(rom[0x7fd5] + (rom[0x7fd6] << 8)) != 0x1420 &&
+		(rom[0x7fd5] + (rom[0x7fd6] << 8)) != 0x1520 &&
+		(rom[0x7fd5] + (rom[0x7fd6] << 8)) != 0x1A20 &&
+		(rom[0x7fd5] + (rom[0x7fd6] << 8)) != 0x3423 && // exclude SA-1
+		(rom[0x7fd5] + (rom[0x7fd6] << 8)) != 0x3523 &&
+		(rom[0x7fd5] + (rom[0x7fd6] << 8)) != 0x4332 && // exclude S-DD1
+		(rom[0x7fd5] + (rom[0x7fd6] << 8)) != 0x4532 &&
+		(rom[0xffd5] + (rom[0xffd6] << 8)) != 0xF93a && // exclude SPC7110
+		(rom[0xffd5] + (rom[0xffd6] << 8)) != 0xF53a)
+		extended = true;
+
+	// if both vectors are invalid, it's type 1 interleaved LoROM
+	if (!extended && allow_interleave &&
+		((rom[0x7ffc] + (rom[0x7ffd] << 8)) < 0x8000) &&
+		((rom[0xfffc] + (rom[0xfffd] << 8)) < 0x8000))
+	{
+		image.interleave[0] = image.fill_size;
+		ProbeView(image, 0, rom);
+	}
+
+	int	hi_score = ScoreHiROMData(rom, image.size);
+	int	lo_score = ScoreLoROMData(rom, image.size);
+
+	if (extended)
+	{
+		std::vector<uint8>	swapped(0x10000);
+
+		ProbeView(image, 0x400000, &swapped[0]);
+
+		int	swappedhirom = ScoreHiROMData(&swapped[0], image.size);
+		int	swappedlorom = ScoreLoROMData(&swapped[0], image.size);
+
+		if (max(swappedlorom, swappedhirom) >= max(lo_score, hi_score))
+		{
+			bigfirst = true;
+			hi_score = swappedhirom;
+			lo_score = swappedlorom;
+			view.swap(swapped);
+			rom = &view[0];
+		}
+	}
+
+	bool	interleaved = false;
+
+	hirom = lo_score < hi_score;
+
+	uint8	map = rom[hirom ? 0xffd5 : 0x7fd5];
+
+	if ((map & 0xf0) == 0x20 || (map & 0xf0) == 0x30)
+	{
+		if (!hirom)
+			interleaved = (map & 0xf) == 1;		// 5 is interleaved ExHiROM, which isn't handled here
+		else
+			interleaved = (map & 0xf) == 0 || (map & 0xf) == 3;
+	}
+
+	if (bigfirst)
+		ProbeView(image, 0, rom);
+
+	// this two games fail to be detected
+	if (strncmp((char *) &rom[0x7fc0], "YUYU NO QUIZ DE GO!GO!", 22) == 0 ||
+	   (strncmp((char *) &rom[0xffc0], "BATMAN--REVENGE JOKER",  21) == 0))
+	{
+		hirom = false;
+		interleaved = false;
+	}
+
+	if (allow_interleave && interleaved)
+	{
+		hirom = !hirom;
+		image.interleave[1] = image.size;
+		ProbeView(image, 0, rom);
+
+		hi_score = ScoreHiROMData(rom, image.size);
+		lo_score = ScoreLoROMData(rom, image.size);
+
+		if ((hirom && (lo_score >= hi_score || hi_score < 0)) || (!hirom && (hi_score > lo_score || lo_score < 0)))
+			return (false);
+	}
+
+	image.smallfirst = extended && !bigfirst;
+
+	return (true);
+}
+
+static void ProbeContents (const uint8 *RomHeader, const uint8 *rom, char *str)
+{
+	static const char	*contents[3] = { "ROM", "ROM+RAM", "ROM+RAM+BAT" };
+
+	uint8	ROMSpeed = RomHeader[0x25];
+	uint8	ROMType  = RomHeader[0x26];
+
+	if (ROMType == 0)
+	{
+		strcpy(str, "ROM");
+		return;
+	}
+
+	const char	*chip = "";
+
+	// the detection in InitROM
+	switch (((ROMType & 0xff) << 8) + (ROMSpeed & 0xff))
+	{
+		case 0x5535:	chip = "+S-RTC";		break;
+		case 0xF93A:	chip = "+SPC7110+RTC";	break;
+		case 0xF53A:	chip = "+SPC7110";		break;
+		case 0x2530:	chip = "+OBC1";			break;
+		case 0x3423:
+		case 0x3523:	chip = "+SA-1";			break;
+		case 0x1320:
+		case 0x1420:
+		case 0x1520:
+		case 0x1A20:
+		case 0x1330:
+		case 0x1430:
+		case 0x1530:
+		case 0x1A30:	chip = "+Super FX";		break;
+		case 0x4332:
+		case 0x4532:	chip = "+S-DD1";		break;
+		case 0xF530:	chip = "+ST-018";		break;
+		case 0xF630:	chip = (rom[0x7FD7] == 0x09) ? "+ST-011" : "+ST-010";	break;
+		case 0xF320:	chip = "+C4";			break;
+
+		default:
+			if (ROMType == 0x03)
+				chip = (ROMSpeed == 0x30) ? "+DSP-4" : "+DSP-1";
+			else
+			if (ROMType == 0x05)
+				chip = (ROMSpeed == 0x20) ? "+DSP-2" : (ROMSpeed == 0x30 && RomHeader[0x2a] == 0xb2) ? "+DSP-3" : "+DSP-1";
+			break;
+	}
+
+	sprintf(str, "%s%s", contents[(ROMType & 0xf) % 3], chip);
+}
+
+bool8 S9xProbeROM (const char *filename, SROMProbe *info)
+{
+	memset(info, 0, sizeof(SROMProbe));
+
+	SProbeImage	image;
+	uint32		file_size = 0, zip_crc = 0;
+	bool8		zipped = FALSE;
+
+	image.stream = NULL;
+	image.length = 0;
+	image.at_end = false;
+
+	auto path = splitpath(filename);
+	if (path.ext_is(".zip") || path.ext_is(".msu1"))
+	{
+	#ifdef UNZIP_SUPPORT
+		image.stream = OpenZipROMStream(filename, &file_size, &zip_crc);
+		zipped = TRUE;
+	#endif
+	}
+	else
+	if (!path.ext_is(".jma"))	// JMA archives can only be extracted whole
+		image.stream = openStreamFromFSTREAM(filename, "rb");
+
+	if (!image.stream)
+		return (FALSE);
+
+	// Outside a zip, the size (and the CRC) need the whole file anyway
+	if (zipped)
+		file_size = min(file_size, (uint32) CMemory::MAX_ROM_SIZE + 0x200);
+	else
+	{
+		ProbeReadAll(image);
+		file_size = image.length;
+	}
+
+	if (file_size == 0)
+	{
+		image.stream->closeStream();
+		return (FALSE);
+	}
+
+	// HeaderRemove, then the headered score in LoadROMInt
+	image.header = (file_size % 0x2000 == 512) ? 512 : 0;
+
+	if (image.header == 0)
+	{
+		ProbeRead(image, 0x10200);
+
+		const uint8	*rom = &image.data[0];
+		int			score_nonheadered = max(ScoreHiROMData(rom, 0), ScoreLoROMData(rom, 0));
+		int			score_headered    = max(ScoreHiROMData(rom + 0x200, 0), ScoreLoROMData(rom + 0x200, 0));
+
+		score_headered += (((file_size - 512) & 0xFFFF) == 0) ? 2 : -2;
+		score_headered += (CountZeroes(rom, 512) >= 0x1E0) ? 2 : -2;
+
+		if (score_headered > score_nonheadered)
+			image.header = 512;
+	}
+
+	image.fill_size = file_size - image.header;
+	image.size = ((image.fill_size + 0x1fff) / 0x2000) * 0x2000;
+
+	bool	hirom, bigfirst;
+
+	if (!ProbeLayout(image, true, hirom, bigfirst))
+		ProbeLayout(image, false, hirom, bigfirst);
+
+	// InitROM's header location
+	std::vector<uint8>	view(0x10000), low(0x10000);
+
+	ProbeView(image, bigfirst ? 0x400000 : 0, &view[0]);
+	ProbeView(image, 0, &low[0]);
+
+	const uint8	*RomHeader = &view[hirom ? 0xffb0 : 0x7fb0];
+
+	memcpy(info->title, &RomHeader[0x10], ROM_NAME_LEN - 2);
+	for (int i = ROM_NAME_LEN - 3; i >= 0 && (info->title[i] == ' ' || info->title[i] == 0); i--)
+		info->title[i] = 0;
+
+	info->mapping     = hirom ? ((image.size > 0x400000 && (bigfirst || image.smallfirst)) ? "ExHiROM" : "HiROM") : "LoROM";
+	info->region_code = RomHeader[0x29];
+	info->region      = RegionName(info->region_code);
+	ProbeContents(RomHeader, &low[0], info->contents);
+
+	info->headered = image.header != 0;
+	info->size     = file_size - image.header;
+
+	// ROMCRC32 covers CalculatedSize bytes of the ROM as loaded; every step
+	// above moves whole 0x2000 blocks
+	if (zipped && !image.header && image.fill_size == image.size &&
+		!image.interleave[0] && !image.interleave[1] && !image.smallfirst)
+		info->crc32 = zip_crc;
+	else
+	{
+		uint32	crc32 = 0xffffffff;
+
+		for (uint32 offset = 0; offset < image.size; offset += 0x2000)
+		{
+			uint32	src = ProbeSourceOffset(image, offset);
+
+			ProbeRead(image, src + 0x2000);
+			crc32 = ~caCRC32(&image.data[src], 0x2000, crc32);
+		}
+
+		info->crc32 = ~crc32;
+	}
+
+	image.stream->closeStream();
+
+	info->valid = TRUE;
+
+	return (TRUE);
+}
+
+std::vector<SROMProbe> S9xProbeROMs (const std::vector<std::string> &filenames, int threads)
+{
+	std::vector<SROMProbe>	results(filenames.size());
+
+#ifdef ROM_PROBE_THREADS
+	if (threads <= 0)
+		threads = std::thread::hardware_concurrency();
+	threads = max(1, min(threads, (int) filenames.size()));
+
+	std::atomic<size_t>	next(0);
+
+	auto worker = [&]() {
+		for (size_t i; (i = next++) < filenames.size(); )
+			S9xProbeROM(filenames[i].c_str(), &results[i]);
+	};
+
+	std::vector<std::thread>	pool;
+
+	for (int i = 1; i < threads; i++)
+		pool.push_back(std::thread(worker));
+
+	worker();
+
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+#else
+	for (size_t i = 0; i < filenames.size(); i++)
+		S9xProbeROM(filenames[i].c_str(), &results[i]);
+#endif
+
+	return (results);
+}
+
 bool8 CMemory::LoadROMInt (int32 ROMfillSize)
 {
 	Settings.DisplayColor = BUILD_PIXEL(31, 31, 31);
@@ -1844,6 +2409,13 @@ void CMemory::ClearSRAM (bool8 onlyNonSavedSRAM)
 			return;
 	// TODO: If SRAM size changes change this value as well
 	memset(SRAM, SNESGameFixes.SRAMInitialValue, 0x80000);
+	MarkAllDirty();
+}
+
+void CMemory::MarkAllDirty (void)
+{
+	RAMDirty = VRAMDirty = ~0u;
+	memset(SRAMDirty, 0xff, sizeof(SRAMDirty));
 }
 
 bool8 CMemory::LoadSRAM (const char *filename)
@@ -1994,12 +2566,17 @@ bool8 CMemory::SaveMPAK (const char *filename)
 
 // initialization
 
-static uint32 caCRC32 (uint8 *array, uint32 size, uint32 crc32)
+static uint32 caCRC32 (const uint8 *array, uint32 size, uint32 crc32)
 {
+#ifdef ZLIB
+	// same polynomial, but zlib's version works on several bytes at a time
+	return ((uint32) ::crc32(~crc32 & 0xFFFFFFFF, array, size));
+#else
 	for (uint32 i = 0; i < size; i++)
 		crc32 = ((crc32 >> 8) & 0x00FFFFFF) ^ crc32Table[(crc32 ^ array[i]) & 0xFF];
 
 	return (~crc32);
+#endif
 }
 
 void CMemory::ParseSNESHeader (uint8 *RomHeader)
@@ -2312,6 +2889,12 @@ void CMemory::InitROM (void)
 			Map_LoROMMap();
     }
 
+	S9xCoverageInit();
+
+#ifdef DEBUGGER
+	S9xRefreshWatchpoints();
+#endif
+
 	Checksum_Calculate();
 
 	bool8 isChecksumOK = (ROMChecksum + ROMComplementChecksum == 0xffff) &
@@ -2342,6 +2925,8 @@ void CMemory::InitROM (void)
 		ROM[offset + 23] = BSMagic1;
 	}
 
+	S9xPerfReset();
+
 	// NTSC/PAL
 	if (Settings.ForceNTSC)
 		Settings.PAL = FALSE;
@@ -3346,7 +3931,12 @@ const char * CMemory::KartContents (void)
 
 const char * CMemory::Country (void)
 {
-	switch (ROMRegion)
+	return (RegionName(ROMRegion));
+}
+
+static const char * RegionName (uint8 region)
+{
+	switch (region)
 	{
 		case 0:		return("Japan");
 		case 1:		return("USA and Canada");
@@ -3575,31 +4165,87 @@ static uint32 XPSdecode (const uint8 *data, unsigned &addr, unsigned size)
 
 static std::vector<uint8_t> ReadStreamUntilEOF(Stream *r)
 {
-    const size_t max_buffer_size = 4096;
+    const size_t chunk_size = 65536;
     std::vector<uint8_t> data;
-    uint8_t buffer[max_buffer_size];
     size_t total_size = 0;
-    size_t buffer_size = 0;
 
-    int value = 0;
-    while (value != EOF)
+    // Reader lacks size(), so grow the buffer a chunk at a time
+    for (;;)
     {
-        value = r->get_char();
-        if (value != EOF)
-            buffer[buffer_size++] = value;
+        data.resize(total_size + chunk_size);
 
-        if (buffer_size == max_buffer_size || (value == EOF && buffer_size > 0))
-        {
-            data.resize(data.size() + buffer_size);
-            memcpy(&data[total_size], buffer, buffer_size);
-            total_size += buffer_size;
-            buffer_size = 0;
-        }
+        size_t read_size = r->read(&data[total_size], chunk_size);
+        if (read_size == 0 || read_size > chunk_size)
+            break;
+
+        total_size += read_size;
     }
 
+    data.resize(total_size);
     return data;
 }
 
+// UPS and BPS patches carry the CRC32 of their output. Once a patch has been
+// applied to a ROM and the result checked, applying it to the same ROM again
+// gives the same bytes, so a reload in the same session skips the CRC pass over
+// the patched image. The patch and source CRCs that key the cache are still
+// computed on every load, and nothing is kept once the emulator exits.
+struct SPatchResult
+{
+	uint32	patch_crc32;
+	uint32	source_crc32;
+	uint32	target_crc32;
+	uint32	target_size;
+};
+
+#define PATCH_RESULT_CACHE_SIZE	16
+
+static std::vector<SPatchResult>	PatchResults;
+
+static bool PatchResultKnown (uint32 patch_crc32, uint32 source_crc32, uint32 target_crc32, uint32 target_size)
+{
+	for (size_t i = 0; i < PatchResults.size(); i++)
+	{
+		const SPatchResult	&result = PatchResults[i];
+
+		if (result.patch_crc32 == patch_crc32 && result.source_crc32 == source_crc32 &&
+			result.target_crc32 == target_crc32 && result.target_size == target_size)
+			return (true);
+	}
+
+	return (false);
+}
+
+static void RememberPatchResult (uint32 patch_crc32, uint32 source_crc32, uint32 target_crc32, uint32 target_size)
+{
+	if (PatchResultKnown(patch_crc32, source_crc32, target_crc32, target_size))
+		return;
+
+	if (PatchResults.size() == PATCH_RESULT_CACHE_SIZE)
+		PatchResults.erase(PatchResults.begin());
+
+	SPatchResult	result = { patch_crc32, source_crc32, target_crc32, target_size };
+	PatchResults.push_back(result);
+}
+
+// UPS runs are XORed eight bytes at a time; the compiler widens this further
+// where the target has vector registers
+static void XorBytes (uint8 *dst, const uint8 *src, uint32 size)
+{
+	for (; size >= 8; size -= 8, dst += 8, src += 8)
+	{
+		uint64	a, b;
+
+		memcpy(&a, dst, 8);
+		memcpy(&b, src, 8);
+		a ^= b;
+		memcpy(dst, &a, 8);
+	}
+
+	while (size--)
+		*dst++ ^= *src++;
+}
+
 //NOTE: UPS patches are *never* created against a headered ROM!
 //this is per the UPS file specification. however, do note that it is
 //technically possible for a non-compliant patcher to ignore this requirement.
@@ -3613,7 +4259,7 @@ static bool8 ReadUPSPatch (Stream *r, long, int32 &rom_size)
 {
 	//Reader lacks size() and rewind(), so we need to read in the file to get its size
 	auto data_vector = ReadStreamUntilEOF(r);
-	uint8 *data = &data_vector[0];
+	uint8 *data = data_vector.data();
 	uint32 size = data_vector.size();
 
 	//4-byte header + 1-byte input size + 1-byte output size + 4-byte patch CRC32 + 4-byte unpatched CRC32 + 4-byte patched CRC32
@@ -3637,27 +4283,41 @@ static bool8 ReadUPSPatch (Stream *r, long, int32 &rom_size)
 
 	//fill expanded area with 0x00s; so that XORing works as expected below.
 	//note that this is needed (and works) whether output ROM is larger or smaller than pre-patched ROM
-	for(unsigned i = min((uint32) rom_size, out_size); i < max((uint32) rom_size, out_size); i++) {
-		Memory.ROM[i] = 0x00;
-	}
+	uint32 fill_start = min((uint32) rom_size, out_size);
+	memset(Memory.ROM + fill_start, 0, max((uint32) rom_size, out_size) - fill_start);
 
 	uint32 relative = 0;
 	while(addr < size - 12) {
 		relative += XPSdecode(data, addr, size);
-		while(addr < size - 12) {
-			uint8 x = data[addr++];
-			Memory.ROM[relative++] ^= x;
-			if(!x) break;
+
+		//a run ends with (and includes) the first zero byte
+		const uint8 *end = (const uint8 *) memchr(data + addr, 0, size - 12 - addr);
+		uint32 length = end ? (uint32) (end - (data + addr)) + 1 : size - 12 - addr;
+
+		if(relative > CMemory::MAX_ROM_SIZE || length > CMemory::MAX_ROM_SIZE - relative) {
+			fprintf(stderr, "WARNING: UPS patch writes past the end of the ROM.\nGame may not be playable.\n");
+			return false;
 		}
+
+		XorBytes(Memory.ROM + relative, data + addr, length);
+		relative += length;
+		addr += length;
 	}
 
 	rom_size = out_size;
 
-	uint32 out_crc32 = caCRC32(Memory.ROM, rom_size);
+	uint32 target_crc32 = (rom_crc32 == px_crc32) ? py_crc32 : px_crc32;
 	if(Settings.IgnorePatchChecksum
-	|| ((rom_crc32 == px_crc32) && (out_crc32 == py_crc32))
+	|| PatchResultKnown(patch_crc32, rom_crc32, target_crc32, out_size)) {
+		Settings.IsPatched = 3;
+		return true;
+	}
+
+	uint32 out_crc32 = caCRC32(Memory.ROM, rom_size);
+	if(((rom_crc32 == px_crc32) && (out_crc32 == py_crc32))
 	|| ((rom_crc32 == py_crc32) && (out_crc32 == px_crc32))
 	) {
+		RememberPatchResult(patch_crc32, rom_crc32, out_crc32, out_size);
 		Settings.IsPatched = 3;
 		return true;
 	} else {
@@ -3683,7 +4343,7 @@ static bool8 ReadUPSPatch (Stream *r, long, int32 &rom_size)
 static bool8 ReadBPSPatch (Stream *r, long, int32 &rom_size)
 {
 	auto data_vector = ReadStreamUntilEOF(r);
-	uint8 *data = &data_vector[0];
+	uint8 *data = data_vector.data();
 	uint32 size = data_vector.size();
 
 	/* 4-byte header + 1-byte input size + 1-byte output size + 1-byte metadata size
@@ -3712,23 +4372,28 @@ static bool8 ReadBPSPatch (Stream *r, long, int32 &rom_size)
 	uint32 outputOffset = 0, sourceRelativeOffset = 0, targetRelativeOffset = 0;
 
 	std::vector<uint8_t> patched_rom_vector(target_size);
-	uint8 *patched_rom = &patched_rom_vector[0];
-	memset(patched_rom, 0, target_size);
+	uint8 *patched_rom = patched_rom_vector.data();
 
-	while(addr < size - 12) {
+	//every command is checked against the buffers before it is copied, so a
+	//damaged patch fails instead of reading or writing out of bounds
+	bool valid = true;
+	while(valid && addr < size - 12) {
 		uint32 length = XPSdecode(data, addr, size);
 		uint32 mode = length & 3;
 		length = (length >> 2) + 1;
 
+		if(length > target_size - outputOffset) { valid = false; break; }
+
 		switch((int)mode) {
 			case SourceRead:
-				while(length--) {
-					patched_rom[outputOffset] = Memory.ROM[outputOffset];
-					outputOffset++;
-				}
+				memcpy(patched_rom + outputOffset, Memory.ROM + outputOffset, length);
+				outputOffset += length;
 				break;
 			case TargetRead:
-				while(length--) patched_rom[outputOffset++] = data[addr++];
+				if(length > size - 12 - addr) { valid = false; break; }
+				memcpy(patched_rom + outputOffset, data + addr, length);
+				outputOffset += length;
+				addr += length;
 				break;
 			case SourceCopy:
 			case TargetCopy:
@@ -3739,17 +4404,49 @@ static bool8 ReadBPSPatch (Stream *r, long, int32 &rom_size)
 
 				if(mode == SourceCopy) {
 					sourceRelativeOffset += offset;
-					while(length--) patched_rom[outputOffset++] = Memory.ROM[sourceRelativeOffset++];
+					if(sourceRelativeOffset > CMemory::MAX_ROM_SIZE || length > CMemory::MAX_ROM_SIZE - sourceRelativeOffset) { valid = false; break; }
+					memcpy(patched_rom + outputOffset, Memory.ROM + sourceRelativeOffset, length);
+					outputOffset += length;
+					sourceRelativeOffset += length;
 				} else {
 					targetRelativeOffset += offset;
-					while(length--) patched_rom[outputOffset++] = patched_rom[targetRelativeOffset++];
+					if(targetRelativeOffset > target_size || length > target_size - targetRelativeOffset) { valid = false; break; }
+
+					//the source may overlap what this command writes (a repeating
+					//pattern), so copy at most one period at a time
+					uint32 distance = outputOffset - targetRelativeOffset;
+					if(targetRelativeOffset >= outputOffset) {
+						while(length--) patched_rom[outputOffset++] = patched_rom[targetRelativeOffset++];
+					} else if(distance == 1) {
+						memset(patched_rom + outputOffset, patched_rom[targetRelativeOffset], length);
+						outputOffset += length;
+						targetRelativeOffset += length;
+					} else {
+						while(length) {
+							uint32 chunk = min(length, distance);
+							memcpy(patched_rom + outputOffset, patched_rom + targetRelativeOffset, chunk);
+							outputOffset += chunk;
+							targetRelativeOffset += chunk;
+							length -= chunk;
+						}
+					}
 				}
 				break;
 		}
 	}
 
-	uint32 out_crc32 = caCRC32(patched_rom, target_size);
-	if(Settings.IgnorePatchChecksum || out_crc32 == target_crc32) {
+	if(!valid) {
+		fprintf(stderr, "WARNING: BPS patch is damaged.\nROM has not been altered.\n");
+		return false;
+	}
+
+	bool verified = Settings.IgnorePatchChecksum || PatchResultKnown(patch_crc32, rom_crc32, target_crc32, target_size);
+	if(!verified && caCRC32(patched_rom, target_size) == target_crc32) {
+		RememberPatchResult(patch_crc32, rom_crc32, target_crc32, target_size);
+		verified = true;
+	}
+
+	if(verified) {
 		memcpy(Memory.ROM, patched_rom, target_size);
 		rom_size = target_size;
 		Settings.IsPatched = 2;
@@ -3760,97 +4457,102 @@ static bool8 ReadBPSPatch (Stream *r, long, int32 &rom_size)
 	}
 }
 
-static long ReadInt (Stream *r, unsigned nbytes)
+static uint32 ReadBE (const uint8 *p, unsigned nbytes)
 {
-	long	v = 0;
+	uint32	v = 0;
 
 	while (nbytes--)
+		v = (v << 8) | *p++;
+
+	return (v);
+}
+
+// Copies an IPS record into the ROM. Offsets count from the start of the file,
+// so bytes that land in a removed copier header are dropped.
+static void PatchIPSRecord (long ofs, const uint8 *data, long len, bool rle)
+{
+	if (ofs < 0)
 	{
-		int	c = r->get_char();
-		if (c == EOF)
-			return (-1);
-		v = (v << 8) | (c & 0xFF);
+		if (ofs + len <= 0)
+			return;
+
+		if (!rle)
+			data -= ofs;
+		len += ofs;
+		ofs = 0;
 	}
 
-	return (v);
+	if (rle)
+		memset(Memory.ROM + ofs, *data, len);
+	else
+		memcpy(Memory.ROM + ofs, data, len);
 }
 
 static bool8 ReadIPSPatch (Stream *r, long offset, int32 &rom_size)
 {
-	const int32	IPS_EOF = 0x00454F46l;
-	int32		ofs;
-	char		fname[6];
+	const long	IPS_EOF = 0x00454F46l;
 
-	fname[5] = 0;
-	for (int i = 0; i < 5; i++)
-	{
-		int	c = r->get_char();
-		if (c == EOF)
-			return (0);
-		fname[i] = (char) c;
-	}
+	// The whole patch is read once and applied record by record
+	std::vector<uint8>	patch = ReadStreamUntilEOF(r);
+	const uint8			*data = patch.data();
+	uint32				size = patch.size(), addr = 5;
 
-	if (strncmp(fname, "PATCH", 5))
+	if (size < 5 || strncmp((const char *) data, "PATCH", 5))
 		return (0);
 
 	for (;;)
 	{
-		long	len, rlen;
-		int		rchar;
-
-		ofs = ReadInt(r, 3);
-		if (ofs == -1)
+		if (size - addr < 3)
 			return (0);
 
+		long	ofs = ReadBE(data + addr, 3);
+		addr += 3;
+
 		if (ofs == IPS_EOF)
 			break;
 
 		ofs -= offset;
 
-		len = ReadInt(r, 2);
-		if (len == -1)
+		if (size - addr < 2)
 			return (0);
 
+		long	len = ReadBE(data + addr, 2);
+		addr += 2;
+
 		if (len)
 		{
-			if (ofs + len > CMemory::MAX_ROM_SIZE)
+			if (size - addr < (uint32) len || ofs + len > CMemory::MAX_ROM_SIZE)
 				return (0);
 
-			while (len--)
-			{
-				rchar = r->get_char();
-				if (rchar == EOF)
-					return (0);
-				Memory.ROM[ofs++] = (uint8) rchar;
-			}
-
-			if (ofs > rom_size)
-				rom_size = ofs;
+			PatchIPSRecord(ofs, data + addr, len, false);
+			addr += len;
 		}
 		else
 		{
-			rlen = ReadInt(r, 2);
-			if (rlen == -1)
+			if (size - addr < 3)
 				return (0);
 
-			rchar = r->get_char();
-			if (rchar == EOF)
-				return (0);
+			len = ReadBE(data + addr, 2);
 
-			if (ofs + rlen > CMemory::MAX_ROM_SIZE)
+			if (ofs + len > CMemory::MAX_ROM_SIZE)
 				return (0);
 
-			while (rlen--)
-				Memory.ROM[ofs++] = (uint8) rchar;
-
-			if (ofs > rom_size)
-				rom_size = ofs;
+			PatchIPSRecord(ofs, data + addr + 2, len, true);
+			addr += 3;
 		}
+
+		if (ofs + len > rom_size)
+			rom_size = ofs + len;
 	}
 
-	ofs = ReadInt(r, 3);
-	if (ofs != -1 && ofs - offset < rom_size)
-		rom_size = ofs - offset;
+	// an optional truncation offset follows EOF
+	if (size - addr >= 3)
+	{
+		long	ofs = ReadBE(data + addr, 3);
+
+		if (ofs - offset < rom_size)
+			rom_size = ofs - offset;
+	}
 
 	Settings.IsPatched = 1;
 	return (1);
@@ -50,6 +50,8 @@ struct CMemory
 		MAP_SETA_DSP,
 		MAP_SETA_RISC,
 		MAP_BSX,
+		MAP_COVERAGE,
+		MAP_WATCH,
 		MAP_NONE,
 		MAP_LAST
 	};
@@ -71,6 +73,12 @@ struct CMemory
 	uint8	*BSRAM;
 	uint8	*BIOSROM;
 
+	// One bit per 4KB page of RAM, VRAM and SRAM written since the golden state
+	// was last captured or restored (see S9xRestoreGoldenState)
+	uint32	RAMDirty;
+	uint32	VRAMDirty;
+	uint32	SRAMDirty[0x80000 >> (MEMMAP_SHIFT + 5)];
+
 	uint8	*Map[MEMMAP_NUM_BLOCKS];
 	uint8	*WriteMap[MEMMAP_NUM_BLOCKS];
 	uint8	BlockIsRAM[MEMMAP_NUM_BLOCKS];
@@ -109,6 +117,7 @@ struct CMemory
 	int		First512BytesCountZeroes() const;
 	uint32	HeaderRemove (uint32, uint8 *);
 	uint32	FileLoader (uint8 *, const char *, uint32);
+	uint32	FileLoaderInt (uint8 *, const char *, uint32);
     bool8   LoadROMMem (const uint8 *, uint32, const char* optional_rom_filename = NULL);
 	bool8	LoadROM (const char *);
     bool8	LoadROMInt (int32);
@@ -121,6 +130,7 @@ struct CMemory
 	bool8	LoadSRAM (const char *);
 	bool8	SaveSRAM (const char *);
 	void	ClearSRAM (bool8 onlyNonSavedSRAM = 0);
+	void	MarkAllDirty (void);
 	bool8	LoadSRTC (void);
 	bool8	SaveSRTC (void);
 	bool8	SaveMPAK (const char *);
@@ -202,6 +212,23 @@ struct SMulti
 extern CMemory	Memory;
 extern SMulti	Multi;
 
+// For stores through Map/WriteMap pointers, which may land in RAM, SRAM or
+// elsewhere; p must be the address actually written
+inline void S9xMarkDirtyPage (const uint8 *p)
+{
+	size_t	offset = (size_t) ((pint) p - (pint) Memory.RAM);
+
+	if (offset < sizeof(Memory.RAM))
+	{
+		Memory.RAMDirty |= 1u << (offset >> MEMMAP_SHIFT);
+		return;
+	}
+
+	offset = (size_t) ((pint) p - (pint) Memory.SRAM);
+	if (offset < Memory.SRAM_SIZE)
+		Memory.SRAMDirty[offset >> (MEMMAP_SHIFT + 5)] |= 1u << ((offset >> MEMMAP_SHIFT) & 31);
+}
+
 inline bool S9xInterlaceField()
 {
 	return (Memory.FillRAM[0x213F] & 0x80) >> 7;
@@ -209,6 +236,35 @@ inline bool S9xInterlaceField()
 
 void S9xAutoSaveSRAM (void);
 bool8 LoadZip(const char *, uint32 *, uint8 *);
+class Stream;
+Stream * OpenZipROMStream (const char *, uint32 *, uint32 *);
+
+// What S9xProbeROM finds out about a ROM image without loading it. It only
+// reads as far into the file as the candidate headers (or as the CRC needs)
+// and touches no global state, so probes can run in parallel with each other
+// and with emulation.
+struct SROMProbe
+{
+	bool8		valid;
+	bool8		headered;				// a 512-byte copier header was skipped
+	char		title[ROM_NAME_LEN];
+	const char	*mapping;				// as CMemory::MapType
+	const char	*region;				// as CMemory::Country
+	char		contents[64];			// as CMemory::KartContents
+	uint8		region_code;
+	uint32		size;					// without the copier header
+	uint32		crc32;					// as CMemory::ROMCRC32
+};
+
+bool8 S9xProbeROM (const char *, SROMProbe *);
+// Probes the files on up to `threads` threads (0 for one per core)
+std::vector<SROMProbe> S9xProbeROMs (const std::vector<std::string> &, int threads = 0);
+
+// FileLoader keeps the most recently loaded ROM files in memory, up to this
+// many bytes in all, so that switching between games doesn't read and
+// decompress them again. 0 turns the cache off and frees it.
+#define ROM_CACHE_DEFAULT_SIZE	(64 * 1024 * 1024)
+void S9xSetROMCacheSize (size_t);
 
 enum s9xwrap_t
 {
@@ -10,6 +10,12 @@
 #ifndef __WIN32__
 #include <unistd.h>
 #endif
+#ifndef __LIBRETRO__
+#define MOVIE_WRITER_THREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 #include "snes9x.h"
 #include "memmap.h"
 #include "controls.h"
@@ -28,11 +34,19 @@
 #define ftruncate chsize
 #endif
 
+// The input log lives in chunks holding a whole number of samples, so a
+// sample never straddles two of them and recording never moves what's
+// already there. While recording, changed samples and the header are written
+// back to the .smv by a background writer at most WRITER_INTERVAL_MS after
+// the change (every WRITER_INTERVAL_FRAMES samples where there are no threads).
+#define INPUT_CHUNK_SIZE		65536
+#define WRITER_INTERVAL_MS		250
+#define WRITER_INTERVAL_FRAMES	15
+
 #define SMV_MAGIC				0x1a564d53 // SMV0x1a
 #define SMV_VERSION				5
 #define SMV_HEADER_SIZE			64
 #define SMV_EXTRAROMINFO_SIZE	30
-#define BUFFER_GROWTH_SIZE		4096
 
 enum MovieState
 {
@@ -68,12 +82,34 @@ struct SMovie
 	uint8	PortType[2];
 	int8	PortIDs[2][4];
 
-	uint8	*InputBuffer;
-	uint8	*InputBufferPtr;
-	uint32	InputBufferSize;
+	uint8	**InputChunks;
+	uint32	InputChunkCount;
+	uint32	SamplesPerChunk;
+	uint32	InputPosition;		// next sample to read or write
+};
+
+// Everything the writer reads is guarded by Lock; the emulation thread takes
+// it only to change samples or the header.
+struct SMovieWriter
+{
+#ifdef MOVIE_WRITER_THREAD
+	std::thread					Thread;
+	std::mutex					Lock;
+	std::condition_variable		Wake, Idle;
+	bool						Quit, Flush;
+#endif
+	bool	Running;
+	int		Fd;
+	uint32	DataOffset;
+	uint32	Samples;			// length of the log, MaxSample + 1
+	uint32	DirtyFrom, DirtyTo;	// samples that differ from the file
+	bool	HeaderDirty;
+	uint8	Header[SMV_HEADER_SIZE];
+	uint8	Staging[INPUT_CHUNK_SIZE];
 };
 
-static struct SMovie	Movie;
+static struct SMovie		Movie;
+static struct SMovieWriter	Writer;
 
 static uint8	prevPortType[2];
 static int8		prevPortIDs[2][4];
@@ -90,7 +126,19 @@ static void		restore_previous_settings (void);
 static void		store_movie_settings (void);
 static void		restore_movie_settings (void);
 static int		bytes_per_sample (void);
-static void		reserve_buffer_space (uint32);
+static uint8 *	input_sample (uint32);
+static void		free_input (void);
+static uint32	first_input_difference (const uint8 *, uint32);
+static void		copy_input_from (const uint8 *, uint32, uint32);
+static void		copy_input_to (uint8 *, uint32);
+static void		writer_lock (void);
+static void		writer_unlock (void);
+static void		mark_dirty (uint32, uint32);
+static void		mark_header (void);
+static bool		write_at (int, const uint8 *, uint32, uint32);
+static void		write_pending (void);
+static void		start_writer (void);
+static void		stop_writer (void);
 static void		reset_controllers (void);
 static void		read_frame_controller_data (bool);
 static void		write_frame_controller_data (void);
@@ -98,6 +146,7 @@ static void		flush_movie (void);
 static void		truncate_movie (void);
 static int		read_movie_header (FILE *, SMovie *);
 static int		read_movie_extrarominfo (FILE *, SMovie *);
+static void		build_movie_header (uint8 *, SMovie *);
 static void		write_movie_header (FILE *, SMovie *);
 static void		write_movie_extrarominfo (FILE *, SMovie *);
 static void		change_state (MovieState);
@@ -110,6 +159,10 @@ static void		change_state (MovieState);
 #define max(a, b)	(((a) > (b)) ? (a) : (b))
 #endif
 
+#ifndef min
+#define min(a, b)	(((a) < (b)) ? (a) : (b))
+#endif
+
 
 static uint8 Read8 (uint8 *&ptr)
 {
@@ -222,17 +275,234 @@ static int bytes_per_sample (void)
 	return (bytes);
 }
 
-static void reserve_buffer_space (uint32 space_needed)
+// Returns sample n of the input log, allocating its chunk on first use
+static uint8 * input_sample (uint32 n)
+{
+	uint32	chunk = n / Movie.SamplesPerChunk;
+
+	if (chunk >= Movie.InputChunkCount)
+	{
+		uint32	count = max(chunk + 1, Movie.InputChunkCount * 2);
+
+		// only the table of chunk pointers ever grows
+		Movie.InputChunks = (uint8 **) realloc(Movie.InputChunks, count * sizeof(uint8 *));
+		memset(Movie.InputChunks + Movie.InputChunkCount, 0, (count - Movie.InputChunkCount) * sizeof(uint8 *));
+		Movie.InputChunkCount = count;
+	}
+
+	if (!Movie.InputChunks[chunk])
+		Movie.InputChunks[chunk] = new uint8[INPUT_CHUNK_SIZE];
+
+	return (Movie.InputChunks[chunk] + (n % Movie.SamplesPerChunk) * Movie.BytesPerSample);
+}
+
+static void free_input (void)
+{
+	for (uint32 i = 0; i < Movie.InputChunkCount; i++)
+		delete [] Movie.InputChunks[i];
+
+	free(Movie.InputChunks);
+	Movie.InputChunks = NULL;
+	Movie.InputChunkCount = 0;
+}
+
+// Index of the first of the first `samples` samples at data that differs from
+// the log, or `samples` if they all match
+static uint32 first_input_difference (const uint8 *data, uint32 samples)
+{
+	for (uint32 n = 0; n < samples; )
+	{
+		uint32	chunk = n / Movie.SamplesPerChunk;
+		uint32	count = min(samples - n, Movie.SamplesPerChunk);
+
+		if (chunk >= Movie.InputChunkCount || !Movie.InputChunks[chunk])
+			return (n);
+
+		const uint8	*a = Movie.InputChunks[chunk], *b = data + n * Movie.BytesPerSample;
+
+		if (memcmp(a, b, count * Movie.BytesPerSample))
+		{
+			while (!memcmp(a, b, Movie.BytesPerSample))
+			{
+				a += Movie.BytesPerSample;
+				b += Movie.BytesPerSample;
+				n++;
+			}
+
+			return (n);
+		}
+
+		n += count;
+	}
+
+	return (samples);
+}
+
+// Replaces samples [from, to) of the log with those at data
+static void copy_input_from (const uint8 *data, uint32 from, uint32 to)
 {
-	if (space_needed > Movie.InputBufferSize)
+	for (uint32 n = from; n < to; )
 	{
-		uint32 ptr_offset   = Movie.InputBufferPtr - Movie.InputBuffer;
-		uint32 alloc_chunks = space_needed / BUFFER_GROWTH_SIZE;
+		uint32	count = min(to - n, Movie.SamplesPerChunk - n % Movie.SamplesPerChunk);
+
+		memcpy(input_sample(n), data + n * Movie.BytesPerSample, count * Movie.BytesPerSample);
+		n += count;
+	}
+}
+
+static void copy_input_to (uint8 *data, uint32 samples)
+{
+	for (uint32 n = 0; n < samples; n += Movie.SamplesPerChunk)
+		memcpy(data + n * Movie.BytesPerSample, Movie.InputChunks[n / Movie.SamplesPerChunk], min(samples - n, Movie.SamplesPerChunk) * Movie.BytesPerSample);
+}
+
+static void writer_lock (void)
+{
+#ifdef MOVIE_WRITER_THREAD
+	Writer.Lock.lock();
+#endif
+}
+
+static void writer_unlock (void)
+{
+#ifdef MOVIE_WRITER_THREAD
+	Writer.Lock.unlock();
+#endif
+}
 
-		Movie.InputBufferSize = BUFFER_GROWTH_SIZE * (alloc_chunks + 1);
-		Movie.InputBuffer     = (uint8 *) realloc(Movie.InputBuffer, Movie.InputBufferSize);
-		Movie.InputBufferPtr  = Movie.InputBuffer + ptr_offset;
+// Both of these are called with the writer locked
+static void mark_dirty (uint32 from, uint32 to)
+{
+	if (Writer.DirtyFrom >= Writer.DirtyTo)
+	{
+		Writer.DirtyFrom = from;
+		Writer.DirtyTo   = to;
 	}
+	else
+	{
+		Writer.DirtyFrom = min(Writer.DirtyFrom, from);
+		Writer.DirtyTo   = max(Writer.DirtyTo, to);
+	}
+}
+
+static void mark_header (void)
+{
+	build_movie_header(Writer.Header, &Movie);
+	Writer.Samples = Movie.MaxSample + 1;
+	Writer.HeaderDirty = true;
+}
+
+static bool write_at (int fd, const uint8 *data, uint32 size, uint32 offset)
+{
+#ifdef __WIN32__
+	// no pwrite; nothing else touches the descriptor while the writer runs
+	if (lseek(fd, offset, SEEK_SET) < 0)
+		return (false);
+	return (write(fd, data, size) == (int) size);
+#else
+	return (pwrite(fd, data, size, offset) == (ssize_t) size);
+#endif
+}
+
+// Writes the header and the dirty samples, a chunk at a time. Called with the
+// writer locked; the lock is dropped around each write, so the emulation
+// thread only ever waits for a copy into the staging buffer.
+static void write_pending (void)
+{
+	for (;;)
+	{
+		if (Writer.HeaderDirty)
+		{
+			uint8	header[SMV_HEADER_SIZE];
+
+			memcpy(header, Writer.Header, SMV_HEADER_SIZE);
+			Writer.HeaderDirty = false;
+
+			writer_unlock();
+			if (!write_at(Writer.Fd, header, SMV_HEADER_SIZE, 0))
+				printf ("Couldn't write movie header.\n");
+			writer_lock();
+			continue;
+		}
+
+		// samples past the end stay dirty in case the log grows back over them
+		uint32	end = min(Writer.DirtyTo, Writer.Samples);
+		uint32	from = Writer.DirtyFrom;
+
+		if (from >= end)
+			break;
+
+		uint32	count = min(end - from, Movie.SamplesPerChunk - from % Movie.SamplesPerChunk);
+		uint32	size = count * Movie.BytesPerSample;
+
+		memcpy(Writer.Staging, Movie.InputChunks[from / Movie.SamplesPerChunk] + (from % Movie.SamplesPerChunk) * Movie.BytesPerSample, size);
+		Writer.DirtyFrom = from + count;
+
+		writer_unlock();
+		if (!write_at(Writer.Fd, Writer.Staging, size, Writer.DataOffset + from * Movie.BytesPerSample))
+			printf ("Error writing control data.\n");
+		writer_lock();
+	}
+}
+
+#ifdef MOVIE_WRITER_THREAD
+static void writer_thread (void)
+{
+	std::unique_lock<std::mutex>	lock(Writer.Lock);
+
+	for (;;)
+	{
+		Writer.Wake.wait_for(lock, std::chrono::milliseconds(WRITER_INTERVAL_MS), [] { return (Writer.Quit || Writer.Flush); });
+
+		write_pending();
+
+		Writer.Flush = false;
+		Writer.Idle.notify_all();
+
+		if (Writer.Quit)
+			break;
+	}
+}
+#endif
+
+static void start_writer (void)
+{
+	if (Writer.Running || !Movie.File)
+		return;
+
+	// from here on the file is only written through its descriptor
+	fflush(Movie.File);
+
+	writer_lock();
+	Writer.Fd = fileno(Movie.File);
+	Writer.DataOffset = Movie.ControllerDataOffset;
+	mark_header();
+	writer_unlock();
+
+	Writer.Running = true;
+#ifdef MOVIE_WRITER_THREAD
+	Writer.Quit = Writer.Flush = false;
+	Writer.Thread = std::thread(writer_thread);
+#endif
+}
+
+static void stop_writer (void)
+{
+	if (!Writer.Running)
+		return;
+
+#ifdef MOVIE_WRITER_THREAD
+	writer_lock();
+	Writer.Quit = true;
+	writer_unlock();
+	Writer.Wake.notify_one();
+	Writer.Thread.join();
+#else
+	write_pending();
+#endif
+
+	Writer.Running = false;
+	Writer.DirtyFrom = Writer.DirtyTo = 0;
 }
 
 static void reset_controllers (void)
@@ -260,13 +530,15 @@ static void reset_controllers (void)
 
 static void read_frame_controller_data (bool addFrame)
 {
+	uint8	*ptr = input_sample(Movie.InputPosition++);
+
 	// reset code check
-	if (Movie.InputBufferPtr[0] == 0xff)
+	if (ptr[0] == 0xff)
 	{
 		bool reset = true;
 		for (int i = 1; i < (int) Movie.BytesPerSample; i++)
 		{
-			if (Movie.InputBufferPtr[i] != 0xff)
+			if (ptr[i] != 0xff)
 			{
 				reset = false;
 				break;
@@ -275,7 +547,6 @@ static void read_frame_controller_data (bool addFrame)
 
 		if (reset)
 		{
-			Movie.InputBufferPtr += Movie.BytesPerSample;
 			S9xSoftReset();
 			return;
 		}
@@ -284,7 +555,7 @@ static void read_frame_controller_data (bool addFrame)
 	for (int i = 0; i < 8; i++)
 	{
 		if (Movie.ControllersMask & (1 << i))
-			MovieSetJoypad(i, Read16(Movie.InputBufferPtr));
+			MovieSetJoypad(i, Read16(ptr));
 		else
 			MovieSetJoypad(i, 0); // pretend the controller is disconnected
 	}
@@ -294,37 +565,41 @@ static void read_frame_controller_data (bool addFrame)
 		if (Movie.PortType[p] == CTL_MOUSE)
 		{
 			uint8 buf[MOUSE_DATA_SIZE];
-			memcpy(buf, Movie.InputBufferPtr, MOUSE_DATA_SIZE);
-			Movie.InputBufferPtr += MOUSE_DATA_SIZE;
+			memcpy(buf, ptr, MOUSE_DATA_SIZE);
+			ptr += MOUSE_DATA_SIZE;
 			MovieSetMouse(p, buf, !addFrame);
 		}
 		else
 		if (Movie.PortType[p] == CTL_SUPERSCOPE)
 		{
 			uint8 buf[SCOPE_DATA_SIZE];
-			memcpy(buf, Movie.InputBufferPtr, SCOPE_DATA_SIZE);
-			Movie.InputBufferPtr += SCOPE_DATA_SIZE;
+			memcpy(buf, ptr, SCOPE_DATA_SIZE);
+			ptr += SCOPE_DATA_SIZE;
 			MovieSetScope(p, buf);
 		}
 		else
 		if (Movie.PortType[p] == CTL_JUSTIFIER)
 		{
 			uint8 buf[JUSTIFIER_DATA_SIZE];
-			memcpy(buf, Movie.InputBufferPtr, JUSTIFIER_DATA_SIZE);
-			Movie.InputBufferPtr += JUSTIFIER_DATA_SIZE;
+			memcpy(buf, ptr, JUSTIFIER_DATA_SIZE);
+			ptr += JUSTIFIER_DATA_SIZE;
 			MovieSetJustifier(p, buf);
 		}
 	}
 }
 
+// Called with the writer locked
 static void write_frame_controller_data (void)
 {
-	reserve_buffer_space((uint32) (Movie.InputBufferPtr + Movie.BytesPerSample - Movie.InputBuffer));
+	uint32	n = Movie.InputPosition++;
+	uint8	*ptr = input_sample(n);
+
+	mark_dirty(n, n + 1);
 
 	for (int i = 0; i < 8; i++)
 	{
 		if (Movie.ControllersMask & (1 << i))
-			Write16(MovieGetJoypad(i), Movie.InputBufferPtr);
+			Write16(MovieGetJoypad(i), ptr);
 		else
 			MovieSetJoypad(i, 0); // pretend the controller is disconnected
 	}
@@ -335,39 +610,43 @@ static void write_frame_controller_data (void)
 		{
 			uint8 buf[MOUSE_DATA_SIZE];
 			MovieGetMouse(p, buf);
-			memcpy(Movie.InputBufferPtr, buf, MOUSE_DATA_SIZE);
-			Movie.InputBufferPtr += MOUSE_DATA_SIZE;
+			memcpy(ptr, buf, MOUSE_DATA_SIZE);
+			ptr += MOUSE_DATA_SIZE;
 		}
 		else
 		if (Movie.PortType[p] == CTL_SUPERSCOPE)
 		{
 			uint8 buf[SCOPE_DATA_SIZE];
 			MovieGetScope(p, buf);
-			memcpy(Movie.InputBufferPtr, buf, SCOPE_DATA_SIZE);
-			Movie.InputBufferPtr += SCOPE_DATA_SIZE;
+			memcpy(ptr, buf, SCOPE_DATA_SIZE);
+			ptr += SCOPE_DATA_SIZE;
 		}
 		else
 		if (Movie.PortType[p] == CTL_JUSTIFIER)
 		{
 			uint8 buf[JUSTIFIER_DATA_SIZE];
 			MovieGetJustifier(p, buf);
-			memcpy(Movie.InputBufferPtr, buf, JUSTIFIER_DATA_SIZE);
-			Movie.InputBufferPtr += JUSTIFIER_DATA_SIZE;
+			memcpy(ptr, buf, JUSTIFIER_DATA_SIZE);
+			ptr += JUSTIFIER_DATA_SIZE;
 		}
 	}
 }
 
+// Waits until everything recorded so far is in the file
 static void flush_movie (void)
 {
-	if (!Movie.File)
+	if (!Writer.Running)
 		return;
 
-	fseek(Movie.File, 0, SEEK_SET);
-	write_movie_header(Movie.File, &Movie);
-	fseek(Movie.File, Movie.ControllerDataOffset, SEEK_SET);
+#ifdef MOVIE_WRITER_THREAD
+	std::unique_lock<std::mutex>	lock(Writer.Lock);
 
-	if (!fwrite(Movie.InputBuffer, 1, Movie.BytesPerSample * (Movie.MaxSample + 1), Movie.File))
-		printf ("Movie flush failed.\n");
+	Writer.Flush = true;
+	Writer.Wake.notify_one();
+	Writer.Idle.wait(lock, [] { return (!Writer.Flush); });
+#else
+	write_pending();
+#endif
 }
 
 static void truncate_movie (void)
@@ -439,11 +718,11 @@ static int read_movie_extrarominfo (FILE *fd, SMovie *movie)
 	return (SUCCESS);
 }
 
-static void write_movie_header (FILE *fd, SMovie *movie)
+static void build_movie_header (uint8 *buf, SMovie *movie)
 {
-	uint8	buf[SMV_HEADER_SIZE], *ptr = buf;
+	uint8	*ptr = buf;
 
-	memset(buf, 0, sizeof(buf));
+	memset(buf, 0, SMV_HEADER_SIZE);
 
 	Write32(SMV_MAGIC, ptr);
 	Write32(SMV_VERSION, ptr);
@@ -464,6 +743,13 @@ static void write_movie_header (FILE *fd, SMovie *movie)
 		for (int i = 0; i < 4; i++)
 			Write8(movie->PortIDs[p][i], ptr);
 	}
+}
+
+static void write_movie_header (FILE *fd, SMovie *movie)
+{
+	uint8	buf[SMV_HEADER_SIZE];
+
+	build_movie_header(buf, movie);
 
 	if (!fwrite(buf, 1, SMV_HEADER_SIZE, fd))
 		printf ("Couldn't write movie header.\n");
@@ -488,7 +774,10 @@ static void change_state (MovieState new_state)
 		return;
 
 	if (Movie.State == MOVIE_STATE_RECORD)
-		flush_movie();
+		stop_writer();
+	else
+	if (new_state == MOVIE_STATE_RECORD)
+		start_writer();
 
 	if (new_state == MOVIE_STATE_NONE)
 	{
@@ -526,7 +815,7 @@ void S9xMovieFreeze (uint8 **buf, uint32 *size)
 	Write32(Movie.CurrentSample, ptr);
 	Write32(Movie.MaxSample, ptr);
 
-	memcpy(ptr, Movie.InputBuffer, Movie.BytesPerSample * (Movie.MaxSample + 1));
+	copy_input_to(ptr, Movie.MaxSample + 1);
 }
 
 int S9xMovieUnfreeze (uint8 *buf, uint32 size)
@@ -551,13 +840,20 @@ int S9xMovieUnfreeze (uint8 *buf, uint32 size)
 
 	if (Settings.WrongMovieStateProtection)
 		if (movie_id != Movie.MovieId)
-			if (max_frame < Movie.MaxFrame || max_sample < Movie.MaxSample || memcmp(Movie.InputBuffer, ptr, space_needed))
+			if (max_frame < Movie.MaxFrame || max_sample < Movie.MaxSample || first_input_difference(ptr, max_sample + 1) <= max_sample)
 				return (WRONG_MOVIE_SNAPSHOT);
 
 	if (!Movie.ReadOnly)
 	{
 		change_state(MOVIE_STATE_RECORD);
 
+		// the log is usually the same up to shortly before the snapshot, so
+		// only what follows the first difference is copied and written back;
+		// anything past the old end is new to the file whatever it matches
+		uint32	first = min(first_input_difference(ptr, max_sample + 1), Movie.MaxSample + 1);
+
+		writer_lock();
+
 		Movie.CurrentFrame  = current_frame;
 		Movie.MaxFrame      = max_frame;
 		Movie.CurrentSample = current_sample;
@@ -566,16 +862,16 @@ int S9xMovieUnfreeze (uint8 *buf, uint32 size)
 
 		store_movie_settings();
 
-		reserve_buffer_space(space_needed);
-		memcpy(Movie.InputBuffer, ptr, space_needed);
+		copy_input_from(ptr, first, max_sample + 1);
+		if (first <= max_sample)
+			mark_dirty(first, max_sample + 1);
+		mark_header();
 
-		flush_movie();
-		fseek(Movie.File, Movie.ControllerDataOffset + (Movie.BytesPerSample * (Movie.CurrentSample + 1)), SEEK_SET);
+		writer_unlock();
 	}
 	else
 	{
-      uint32   space_processed = (Movie.BytesPerSample * (current_sample + 1));
-      if (current_frame > Movie.MaxFrame || current_sample > Movie.MaxSample || memcmp(Movie.InputBuffer, ptr, space_processed))
+		if (current_frame > Movie.MaxFrame || current_sample > Movie.MaxSample || first_input_difference(ptr, current_sample + 1) <= current_sample)
 			return (SNAPSHOT_INCONSISTENT);
 
 		change_state(MOVIE_STATE_PLAY);
@@ -584,7 +880,7 @@ int S9xMovieUnfreeze (uint8 *buf, uint32 size)
 		Movie.CurrentSample = current_sample;
 	}
 
-	Movie.InputBufferPtr = Movie.InputBuffer + (Movie.BytesPerSample * Movie.CurrentSample);
+	Movie.InputPosition = Movie.CurrentSample;
 	read_frame_controller_data(true);
 
 	return (SUCCESS);
@@ -661,16 +957,23 @@ int S9xMovieOpen (const char *filename, bool8 read_only)
 		return (WRONG_FORMAT);
 	}
 
-	Movie.File           = fd;
-	Movie.BytesPerSample = bytes_per_sample();
-	Movie.InputBufferPtr = Movie.InputBuffer;
-	reserve_buffer_space(Movie.BytesPerSample * (Movie.MaxSample + 1));
+	free_input();
+	Movie.File            = fd;
+	Movie.BytesPerSample  = bytes_per_sample();
+	Movie.SamplesPerChunk = INPUT_CHUNK_SIZE / Movie.BytesPerSample;
+	Movie.InputPosition   = 0;
 
-	if (!fread(Movie.InputBufferPtr, 1, Movie.BytesPerSample * (Movie.MaxSample + 1), fd))
+	for (uint32 n = 0; n <= Movie.MaxSample; n += Movie.SamplesPerChunk)
 	{
-		printf ("Failed to read from movie file.\n");
-		fclose(fd);
-		return (WRONG_FORMAT);
+		uint32	count = min(Movie.MaxSample + 1 - n, Movie.SamplesPerChunk);
+
+		if (!fread(input_sample(n), 1, Movie.BytesPerSample * count, fd) && n == 0)
+		{
+			printf ("Failed to read from movie file.\n");
+			fclose(fd);
+			Movie.File = NULL;
+			return (WRONG_FORMAT);
+		}
 	}
 
 	// read "baseline" controller data
@@ -774,10 +1077,14 @@ int S9xMovieCreate (const char *filename, uint8 controllers_mask, uint8 opts, co
 	}
 
 	// write "baseline" controller data
-	Movie.File           = fd;
-	Movie.BytesPerSample = bytes_per_sample();
-	Movie.InputBufferPtr = Movie.InputBuffer;
+	free_input();
+	Movie.File            = fd;
+	Movie.BytesPerSample  = bytes_per_sample();
+	Movie.SamplesPerChunk = INPUT_CHUNK_SIZE / Movie.BytesPerSample;
+	Movie.InputPosition   = 0;
+	writer_lock();
 	write_frame_controller_data();
+	writer_unlock();
 
 	Movie.CurrentFrame  = 0;
 	Movie.CurrentSample = 0;
@@ -897,13 +1204,17 @@ void S9xMovieUpdate (bool addFrame)
 			if (SKIPPED_POLLING_PORT_TYPE(Movie.PortType[0]) && SKIPPED_POLLING_PORT_TYPE(Movie.PortType[1]))
 				return;
 
+			writer_lock();
 			write_frame_controller_data();
 			Movie.MaxSample = ++Movie.CurrentSample;
 			if (addFrame)
 				Movie.MaxFrame = ++Movie.CurrentFrame;
-
-			if (!fwrite((Movie.InputBufferPtr - Movie.BytesPerSample), 1, Movie.BytesPerSample, Movie.File))
-				printf ("Error writing control data.\n");
+			mark_header();
+		#ifndef MOVIE_WRITER_THREAD
+			if (Movie.CurrentSample % WRITER_INTERVAL_FRAMES == 0)
+				write_pending();
+		#endif
+			writer_unlock();
 
 			break;
 		}
@@ -922,14 +1233,15 @@ void S9xMovieUpdateOnReset (void)
 {
 	if (Movie.State == MOVIE_STATE_RECORD)
 	{
-		reserve_buffer_space((uint32) (Movie.InputBufferPtr + Movie.BytesPerSample - Movie.InputBuffer));
-		memset(Movie.InputBufferPtr, 0xFF, Movie.BytesPerSample);
-		Movie.InputBufferPtr += Movie.BytesPerSample;
+		uint32	n = Movie.InputPosition++;
+
+		writer_lock();
+		memset(input_sample(n), 0xFF, Movie.BytesPerSample);
+		mark_dirty(n, n + 1);
 		Movie.MaxSample = ++Movie.CurrentSample;
 		Movie.MaxFrame = ++Movie.CurrentFrame;
-
-		if (!fwrite((Movie.InputBufferPtr - Movie.BytesPerSample), 1, Movie.BytesPerSample, Movie.File))
-			printf ("Failed writing reset data.\n");
+		mark_header();
+		writer_unlock();
 	}
 }
 
@@ -954,6 +1266,8 @@ void S9xMovieShutdown (void)
 {
 	if (S9xMovieActive())
 		S9xMovieStop(TRUE);
+
+	free_input();
 }
 
 bool8 S9xMovieActive (void)
@@ -0,0 +1,153 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#include <chrono>
+#include "snes9x.h"
+#include "apu/apu.h"
+#include "perfcounters.h"
+
+std::atomic<uint32>	PerfCurrent[PERF_COUNT];
+
+static std::atomic<uint32>	PerfLastFrame[PERF_COUNT];
+
+static const char	*PerfNames[PERF_COUNT] =
+{
+	"cpu_instructions",
+	"dma_bytes",
+	"hdma_lines",
+	"partial_renders",
+	"tile_misses",
+	"apu_catchups",
+	"smp_skipped_cycles",
+	"sa1_cycles",
+	"superfx_instructions",
+	"audio_buffer",
+	"time_frame_us",
+	"time_video_us",
+	"time_audio_us",
+	"time_input_us"
+};
+
+static struct
+{
+	FILE	*fp;
+	int		interval;
+	int		frames;
+	uint32	frame;
+	uint64	sums[PERF_COUNT];
+}	csv;
+
+void S9xPerfReset (void)
+{
+	for (int i = 0; i < PERF_COUNT; i++)
+	{
+		PerfCurrent[i].store(0, std::memory_order_relaxed);
+		PerfLastFrame[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+static void WriteCSVRow (void)
+{
+	fprintf(csv.fp, "%u", csv.frame);
+
+	for (int i = 0; i < PERF_COUNT; i++)
+	{
+		// The buffer fill is a gauge, report its average over the window
+		if (i == PERF_AUDIO_BUFFER)
+			fprintf(csv.fp, ",%u", (uint32) (csv.sums[i] / csv.frames));
+		else
+			fprintf(csv.fp, ",%llu", (unsigned long long) csv.sums[i]);
+
+		csv.sums[i] = 0;
+	}
+
+	fprintf(csv.fp, "\n");
+	csv.frames = 0;
+}
+
+// Called once per emulated frame from S9xStartScreenRefresh, on the emulation thread.
+// Closing the frame there rather than at the end of the refresh keeps the port's
+// video, audio and input stages, which mostly run after S9xMainLoop returns, inside
+// the frame window instead of leaking into the next one.
+void S9xPerfEndFrame (void)
+{
+	PerfCurrent[PERF_AUDIO_BUFFER].store(S9xGetSampleCount(), std::memory_order_relaxed);
+
+	for (int i = 0; i < PERF_COUNT; i++)
+	{
+		uint32	value = PerfCurrent[i].exchange(0, std::memory_order_relaxed);
+		PerfLastFrame[i].store(value, std::memory_order_relaxed);
+		csv.sums[i] += value;
+	}
+
+	csv.frame++;
+
+	if (csv.fp && ++csv.frames >= csv.interval)
+		WriteCSVRow();
+}
+
+const char * S9xPerfCounterName (int counter)
+{
+	if (counter < 0 || counter >= PERF_COUNT)
+		return (NULL);
+
+	return (PerfNames[counter]);
+}
+
+// Value accumulated during the last completed frame
+uint32 S9xPerfCounterValue (int counter)
+{
+	if (counter < 0 || counter >= PERF_COUNT)
+		return (0);
+
+	return (PerfLastFrame[counter].load(std::memory_order_relaxed));
+}
+
+uint64 S9xPerfTimestamp (void)
+{
+	return (std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Adds the time elapsed since start, a value from S9xPerfTimestamp, to one of the PERF_TIME_ counters
+void S9xPerfAddTime (int counter, uint64 start)
+{
+	PerfCurrent[counter].fetch_add((uint32) (S9xPerfTimestamp() - start), std::memory_order_relaxed);
+}
+
+// Writes one row of per-window totals every `frames` frames until S9xPerfCloseCSV
+bool8 S9xPerfOpenCSV (const char *filename, int frames)
+{
+	S9xPerfCloseCSV();
+
+	csv.fp = fopen(filename, "w");
+	if (!csv.fp)
+		return (FALSE);
+
+	csv.interval = frames > 0 ? frames : 1;
+	csv.frames = 0;
+
+	for (int i = 0; i < PERF_COUNT; i++)
+		csv.sums[i] = 0;
+
+	fprintf(csv.fp, "frame");
+	for (int i = 0; i < PERF_COUNT; i++)
+		fprintf(csv.fp, ",%s", PerfNames[i]);
+	fprintf(csv.fp, "\n");
+
+	return (TRUE);
+}
+
+void S9xPerfCloseCSV (void)
+{
+	if (!csv.fp)
+		return;
+
+	if (csv.frames)
+		WriteCSVRow();
+
+	fclose(csv.fp);
+	csv.fp = NULL;
+}
@@ -0,0 +1,49 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#ifndef _PERFCOUNTERS_H_
+#define _PERFCOUNTERS_H_
+
+#include <atomic>
+
+enum
+{
+	PERF_CPU_INSTRUCTIONS,	// 65c816 instructions executed
+	PERF_DMA_BYTES,			// bytes requested by general purpose DMA
+	PERF_HDMA_LINES,		// HDMA channel transfers, one per channel per line
+	PERF_PARTIAL_RENDERS,	// S9xUpdateScreen calls, i.e. bands flushed by register writes
+	PERF_TILE_MISSES,		// tiles converted on a tile cache miss
+	PERF_APU_CATCHUPS,		// times the SPC700 was run up to the CPU
+	PERF_SMP_SKIPPED_CYCLES,	// SPC700 cycles skipped in idle poll loops
+	PERF_SA1_CYCLES,		// SA-1 master cycles
+	PERF_SUPERFX_INSTRUCTIONS,	// GSU instructions executed
+	PERF_AUDIO_BUFFER,		// samples waiting in the resampler at the end of the frame
+	PERF_TIME_FRAME,		// microseconds spent in S9xMainLoop, video and audio output included
+	PERF_TIME_VIDEO,		// microseconds spent presenting the image
+	PERF_TIME_AUDIO,		// microseconds spent mixing and submitting audio
+	PERF_TIME_INPUT,		// microseconds spent polling input
+	PERF_COUNT
+};
+
+// Counters are only ever bumped by the emulation thread, so a relaxed load and
+// store is enough; the frontend stage timers may be fed from other threads.
+extern std::atomic<uint32>	PerfCurrent[PERF_COUNT];
+
+static inline void S9xPerfAdd (int counter, uint32 n)
+{
+	PerfCurrent[counter].store(PerfCurrent[counter].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void S9xPerfReset (void);
+void S9xPerfEndFrame (void);
+const char * S9xPerfCounterName (int);
+uint32 S9xPerfCounterValue (int);
+uint64 S9xPerfTimestamp (void);
+void S9xPerfAddTime (int, uint64);
+bool8 S9xPerfOpenCSV (const char *, int);
+void S9xPerfCloseCSV (void);
+
+#endif
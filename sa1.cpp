@@ -175,6 +175,12 @@ static void S9xSetSA1MemMap (uint32 which1, uint8 map)
 		for (int i = c + 8; i < c + 16; i++)
 			Memory.Map[start2 + i] = SA1.Map[start2 + i] = block;
 	}
+
+	S9xCoverageRefresh();
+
+#ifdef DEBUGGER
+	S9xRefreshWatchpoints();
+#endif
 }
 
 uint8 S9xGetSA1 (uint32 address)
@@ -615,61 +621,8 @@ static void S9xSA1CharConv2 (void)
 	uint8	*p             = &Memory.FillRAM[0x3000] + (dest & 0x7ff) + offset * bytes_per_char;
 	uint8	*q             = &Memory.ROM[CMemory::MAX_ROM_SIZE - 0x10000] + offset * 64;
 
-	switch (depth)
-	{
-		case 2:
-			for (int l = 0; l < 8; l++, q += 8)
-			{
-				for (int b = 0; b < 8; b++)
-				{
-					uint8	r = *(q + b);
-					*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-					*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-				}
-
-				p += 2;
-			}
-
-			break;
-
-		case 4:
-			for (int l = 0; l < 8; l++, q += 8)
-			{
-				for (int b = 0; b < 8; b++)
-				{
-					uint8	r = *(q + b);
-					*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-					*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-					*(p + 16) = (*(p + 16) << 1) | ((r >> 2) & 1);
-					*(p + 17) = (*(p + 17) << 1) | ((r >> 3) & 1);
-				}
-
-				p += 2;
-			}
-
-			break;
-
-		case 8:
-			for (int l = 0; l < 8; l++, q += 8)
-			{
-				for (int b = 0; b < 8; b++)
-				{
-					uint8	r = *(q + b);
-					*(p +  0) = (*(p +  0) << 1) | ((r >> 0) & 1);
-					*(p +  1) = (*(p +  1) << 1) | ((r >> 1) & 1);
-					*(p + 16) = (*(p + 16) << 1) | ((r >> 2) & 1);
-					*(p + 17) = (*(p + 17) << 1) | ((r >> 3) & 1);
-					*(p + 32) = (*(p + 32) << 1) | ((r >> 4) & 1);
-					*(p + 33) = (*(p + 33) << 1) | ((r >> 5) & 1);
-					*(p + 48) = (*(p + 48) << 1) | ((r >> 6) & 1);
-					*(p + 49) = (*(p + 49) << 1) | ((r >> 7) & 1);
-				}
-
-				p += 2;
-			}
-
-			break;
-	}
+	for (int l = 0; l < 8; l++, q += 8, p += 2)
+		S9xSA1PlanarRow(p, S9xSA1PixelRow(q, 8), depth);
 }
 
 static void S9xSA1DMA (void)
@@ -145,4 +145,68 @@ static inline void S9xSA1FixCycles (void)
 	}
 }
 
+// Character conversion. A row of 8 pixels is held as one byte per pixel,
+// first pixel in the low byte; transposing that 8x8 bit matrix in three
+// swaps gives every bitplane byte of the row at once. Planes 0-1 go to p[0-1],
+// 2-3 to p[16-17] and so on, first pixel in bit 7 as on the PPU.
+static inline uint64 S9xSA1PixelRow (const uint8 *q, int depth)
+{
+	uint64	x;
+
+	switch (depth)
+	{
+		case 2: // 4 pixels per byte, first in bits 0-1
+			x = q[0] | (q[1] << 8);
+			x = (x | (x << 24)) & 0x000000ff000000ffULL;
+			x = (x | (x << 12)) & 0x000f000f000f000fULL;
+			x = (x | (x <<  6)) & 0x0303030303030303ULL;
+			return (x);
+
+		case 4: // 2 pixels per byte, first in bits 0-3
+			x = q[0] | (q[1] << 8) | (q[2] << 16) | ((uint32) q[3] << 24);
+			x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+			x = (x | (x <<  8)) & 0x00ff00ff00ff00ffULL;
+			x = (x | (x <<  4)) & 0x0f0f0f0f0f0f0f0fULL;
+			return (x);
+
+		default:
+			return ((uint64) (q[0] | (q[1] << 8) | (q[2] << 16) | ((uint32) q[3] << 24)) |
+				((uint64) (q[4] | (q[5] << 8) | (q[6] << 16) | ((uint32) q[7] << 24)) << 32));
+	}
+}
+
+static inline void S9xSA1PlanarRow (uint8 *p, uint64 pixels, int depth)
+{
+	uint64	x = pixels, t;
+
+	// reverse the pixels so the first one ends up in bit 7 of each plane
+	x = ((x >>  8) & 0x00ff00ff00ff00ffULL) | ((x & 0x00ff00ff00ff00ffULL) <<  8);
+	x = ((x >> 16) & 0x0000ffff0000ffffULL) | ((x & 0x0000ffff0000ffffULL) << 16);
+	x = (x >> 32) | (x << 32);
+
+	t = (x ^ (x >>  7)) & 0x00aa00aa00aa00aaULL;
+	x = x ^ t ^ (t <<  7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x = x ^ t ^ (t << 28);
+
+	p[0] = (uint8) x;
+	p[1] = (uint8) (x >> 8);
+
+	if (depth > 2)
+	{
+		p[16] = (uint8) (x >> 16);
+		p[17] = (uint8) (x >> 24);
+	}
+
+	if (depth > 4)
+	{
+		p[32] = (uint8) (x >> 32);
+		p[33] = (uint8) (x >> 40);
+		p[48] = (uint8) (x >> 48);
+		p[49] = (uint8) (x >> 56);
+	}
+}
+
 #endif
@@ -6,6 +6,7 @@
 
 #include "snes9x.h"
 #include "memmap.h"
+#include "perfcounters.h"
 
 #define CPU								SA1
 #define ICPU							SA1
@@ -130,6 +131,8 @@ void S9xSA1MainLoop (void)
 	int cycles = CPU.Cycles * 3;
 	#define CPU SA1
 
+	int32	start = SA1.Cycles;
+
 	for (; SA1.Cycles < cycles && !(Memory.FillRAM[0x2200] & 0x60);)
 	{
 	#ifdef DEBUGGER
@@ -164,6 +167,8 @@ void S9xSA1MainLoop (void)
 		(*Opcodes[Op].S9xOpcode)();
 	}
 
+	S9xPerfAdd(PERF_SA1_CYCLES, SA1.Cycles - start);
+
 	S9xSA1UpdateTimer();
 }
 
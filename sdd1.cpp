@@ -21,6 +21,12 @@ void S9xSetSDD1MemoryMap (uint32 bank, uint32 value)
 		for (int i = c; i < c + 16; i++)
 			Memory.Map[i + bank] = block;
 	}
+
+	S9xCoverageRefresh();
+
+#ifdef DEBUGGER
+	S9xRefreshWatchpoints();
+#endif
 }
 
 void S9xResetSDD1 (void)
@@ -1001,6 +1001,36 @@ static void FreezeBlock (STREAM, const char *, uint8 *, int);
 static void FreezeStruct (STREAM, const char *, void *, FreezeData *, int);
 static bool CheckBlockName(STREAM stream, const char *name, int &len);
 static void SkipBlockWithName(STREAM stream, const char *name);
+static int FreezeSize (int, int);
+static void FreezeDigits (char *, int, int);
+static const struct NativePlan * NativePlanFor (FreezeData *, int);
+static uint8 * FreezeScratch (int);
+static uint8 * UnfreezeAlloc (int);
+static void UnfreezeFree (uint8 *);
+static void UnfreezePoolReset (void);
+static void RestoreGoldenMemory (void);
+
+// Set while a fast savestate is written or read: struct fields are copied in host byte order
+static bool8	native_fields = FALSE;
+
+// Blocks are staged in buffers that are kept from one save or load to the next, so run-ahead,
+// which saves and loads every frame, doesn't go through the heap for them
+static uint8	*freeze_scratch = NULL;
+static int		freeze_scratch_size = 0;
+static uint8	*unfreeze_pool = NULL;
+static int		unfreeze_pool_size = 0, unfreeze_pool_used = 0, unfreeze_pool_wanted = 0;
+
+// The golden state is a fast snapshot plus page-aligned copies of RAM, VRAM, SRAM and
+// the APU state block; restoring it loads the snapshot without those blocks and copies
+// back only the 4KB pages marked dirty since (see S9xMarkDirtyPage)
+#define GOLDEN_MEMORY_SIZE	(0x20000 + 0x10000 + 0x80000 + SPC_SAVE_STATE_BLOCK_SIZE)
+
+static uint8	*golden_state = NULL;
+static uint32	golden_state_size = 0;
+static uint8	*golden_memory = NULL;
+static uint8	*golden_ram, *golden_vram, *golden_sram, *golden_apu;
+static uint32	golden_crc32 = 0;
+static bool8	golden_restoring = FALSE;
 
 
 void S9xResetSaveTimer (bool8 dontsave)
@@ -1029,7 +1059,7 @@ bool8 S9xFreezeGameMem (uint8 *buf, uint32 bufSize)
     memStream mStream(buf, bufSize);
 	S9xFreezeToStream(&mStream);
 
-	return (TRUE);
+	return (!mStream.overflowed());
 }
 
 bool8 S9xFreezeGame (const char *filename)
@@ -1065,6 +1095,100 @@ int S9xUnfreezeGameMem (const uint8 *buf, uint32 bufSize)
 	return result;
 }
 
+bool8 S9xCaptureGoldenState (void)
+{
+	S9xReleaseGoldenState();
+
+	bool8	fast = Settings.FastSavestates;
+
+	Settings.FastSavestates = TRUE;
+	golden_state_size = S9xFreezeSize();
+	golden_state = new uint8[golden_state_size];
+	bool8	frozen = S9xFreezeGameMem(golden_state, golden_state_size);
+	Settings.FastSavestates = fast;
+
+	if (!frozen)
+	{
+		S9xReleaseGoldenState();
+		return (FALSE);
+	}
+
+	golden_memory = new uint8[GOLDEN_MEMORY_SIZE + MEMMAP_BLOCK_SIZE];
+	golden_ram    = (uint8 *) (((pint) golden_memory + MEMMAP_MASK) & ~(pint) MEMMAP_MASK);
+	golden_vram   = golden_ram  + sizeof(Memory.RAM);
+	golden_sram   = golden_vram + sizeof(Memory.VRAM);
+	golden_apu    = golden_sram + Memory.SRAM_SIZE;
+
+	memcpy(golden_ram, Memory.RAM, sizeof(Memory.RAM));
+	memcpy(golden_vram, Memory.VRAM, sizeof(Memory.VRAM));
+	memcpy(golden_sram, Memory.SRAM, Memory.SRAM_SIZE);
+	S9xAPUSaveGolden(golden_apu);
+
+	Memory.RAMDirty = Memory.VRAMDirty = 0;
+	memset(Memory.SRAMDirty, 0, sizeof(Memory.SRAMDirty));
+
+	golden_crc32 = Memory.ROMCRC32;
+
+	return (TRUE);
+}
+
+// The register structs, FillRAM and the DSP still go through the fast unfreeze
+// path, so a restore costs 13-17 us even with nothing dirty, plus the copy of
+// every page written since; that is short of the few microseconds a restore from
+// native copies of those structs could reach
+bool8 S9xRestoreGoldenState (void)
+{
+	if (!golden_state || golden_crc32 != Memory.ROMCRC32)
+		return (FALSE);
+
+	bool8	fast = Settings.FastSavestates;
+
+	Settings.FastSavestates = TRUE;
+	golden_restoring = TRUE;
+	int	result = S9xUnfreezeGameMem(golden_state, golden_state_size);
+	golden_restoring = FALSE;
+	Settings.FastSavestates = fast;
+
+	return (result == SUCCESS);
+}
+
+void S9xReleaseGoldenState (void)
+{
+	delete [] golden_state;
+	delete [] golden_memory;
+	golden_state = golden_memory = NULL;
+	golden_state_size = 0;
+}
+
+static void RestoreDirtyPages (uint8 *memory, const uint8 *golden, uint32 dirty)
+{
+	for (uint32 page = 0; dirty; page++, dirty >>= 1)
+	{
+		if (dirty & 1)
+			memcpy(memory + (page << MEMMAP_SHIFT), golden + (page << MEMMAP_SHIFT), MEMMAP_BLOCK_SIZE);
+	}
+}
+
+static void RestoreGoldenMemory (void)
+{
+	RestoreDirtyPages(Memory.RAM, golden_ram, Memory.RAMDirty);
+	RestoreDirtyPages(Memory.VRAM, golden_vram, Memory.VRAMDirty);
+
+	// these chips write SRAM through their own pointers, which don't mark pages, so all
+	// they can reach is copied back
+	if (Settings.SuperFX)
+		memcpy(Memory.SRAM, golden_sram, GSU.nRamBanks << 16);
+	else
+	if (Settings.SA1 || Settings.SETA || Settings.BS)
+		memcpy(Memory.SRAM, golden_sram, Memory.SRAM_SIZE);
+
+	for (uint32 i = 0; i < COUNT(Memory.SRAMDirty); i++)
+		RestoreDirtyPages(Memory.SRAM + (i << (MEMMAP_SHIFT + 5)), golden_sram + (i << (MEMMAP_SHIFT + 5)), Memory.SRAMDirty[i]);
+
+	Memory.RAMDirty = Memory.VRAMDirty = 0;
+	memset(Memory.SRAMDirty, 0, sizeof(Memory.SRAMDirty));
+}
+
 void S9xMessageFromResult(int result, const char* base)
 {
     switch(result)
@@ -1169,14 +1293,18 @@ bool8 S9xUnfreezeScreenshot(const char *filename, uint16 **image_buffer, int &wi
 
 void S9xFreezeToStream (STREAM stream)
 {
-	char	buffer[8192];
-	uint8	*soundsnapshot = new uint8[SPC_SAVE_STATE_BLOCK_SIZE];
+	static const char	name_block[] = "NAM:000008:Removed";
+	char				header[16];
 
-	sprintf(buffer, "%s:%04d\n", SNAPSHOT_MAGIC, SNAPSHOT_VERSION);
-	WRITE_STREAM(buffer, strlen(buffer), stream);
+	native_fields = Settings.FastSavestates;
 
-	sprintf(buffer, "NAM:%06d:%s%c", 8, "Removed", 0);
-	WRITE_STREAM(buffer, strlen(buffer) + 1, stream);
+	memcpy(header, native_fields ? SNAPSHOT_FAST_MAGIC : SNAPSHOT_MAGIC, 8);
+	header[8] = ':';
+	FreezeDigits(header + 9, SNAPSHOT_VERSION, 4);
+	header[13] = '\n';
+	WRITE_STREAM(header, 14, stream);
+
+	WRITE_STREAM((void *) name_block, sizeof(name_block), stream);
 
 	FreezeStruct(stream, "CPU", &CPU, SnapCPU, COUNT(SnapCPU));
 
@@ -1197,6 +1325,7 @@ void S9xFreezeToStream (STREAM stream)
 
 	FreezeBlock (stream, "FIL", Memory.FillRAM, 0x8000);
 
+	uint8	*soundsnapshot = FreezeScratch(SPC_SAVE_STATE_BLOCK_SIZE);
 	S9xAPUSaveState(soundsnapshot);
 	FreezeBlock (stream, "SND", soundsnapshot, SPC_SAVE_STATE_BLOCK_SIZE);
 
@@ -1209,6 +1338,7 @@ void S9xFreezeToStream (STREAM stream)
 
 	if (Settings.SuperFX)
 	{
+		S9xSuperFXPreSaveState();
 		GSU.avRegAddr = (uint8 *) &GSU.avReg;
 		FreezeStruct(stream, "SFX", &GSU, SnapFX, COUNT(SnapFX));
 	}
@@ -1311,7 +1441,7 @@ void S9xFreezeToStream (STREAM stream)
 		}
 	}
 
-	delete [] soundsnapshot;
+	native_fields = FALSE;
 }
 
 int S9xUnfreezeFromStream (STREAM stream)
@@ -1326,7 +1456,9 @@ int S9xUnfreezeFromStream (STREAM stream)
 	if (READ_STREAM(buffer, len, stream) != (unsigned int ) len)
 		return (WRONG_FORMAT);
 
-	if (strncmp(buffer, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC)) != 0)
+	bool8	native = strncmp(buffer, SNAPSHOT_FAST_MAGIC, strlen(SNAPSHOT_FAST_MAGIC)) == 0;
+
+	if (!native && strncmp(buffer, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC)) != 0)
 		return (WRONG_FORMAT);
 
 	version = atoi(&buffer[strlen(SNAPSHOT_MAGIC) + 1]);
@@ -1337,6 +1469,9 @@ int S9xUnfreezeFromStream (STREAM stream)
 	if (result != SUCCESS)
 		return (result);
 
+	native_fields = native;
+	UnfreezePoolReset();
+
 	uint8	*local_cpu           = NULL;
 	uint8	*local_registers     = NULL;
 	uint8	*local_ppu           = NULL;
@@ -1366,6 +1501,9 @@ int S9xUnfreezeFromStream (STREAM stream)
 	uint8	*local_screenshot    = NULL;
 	uint8	*local_movie_data    = NULL;
 
+	if (!golden_restoring)
+		Memory.MarkAllDirty();
+
 	do
 	{
 		result = UnfreezeStructCopy(stream, "CPU", &local_cpu, SnapCPU, COUNT(SnapCPU), version);
@@ -1384,26 +1522,37 @@ int S9xUnfreezeFromStream (STREAM stream)
 		if (result != SUCCESS)
 			break;
 
-		if (fast)
-			result = UnfreezeBlock(stream, "VRA", Memory.VRAM, 0x10000);
+		if (golden_restoring)
+		{
+			// only the pages written since the golden state was taken are copied back
+			SkipBlockWithName(stream, "VRA");
+			SkipBlockWithName(stream, "RAM");
+			SkipBlockWithName(stream, "SRA");
+			RestoreGoldenMemory();
+		}
 		else
-			result = UnfreezeBlockCopy(stream, "VRA", &local_vram, 0x10000);
-		if (result != SUCCESS)
-			break;
+		{
+			if (fast)
+				result = UnfreezeBlock(stream, "VRA", Memory.VRAM, 0x10000);
+			else
+				result = UnfreezeBlockCopy(stream, "VRA", &local_vram, 0x10000);
+			if (result != SUCCESS)
+				break;
 
-		if (fast)
-			result = UnfreezeBlock(stream, "RAM", Memory.RAM, sizeof(Memory.RAM));
-		else
-			result = UnfreezeBlockCopy(stream, "RAM", &local_ram, sizeof(Memory.RAM));
-		if (result != SUCCESS)
-			break;
+			if (fast)
+				result = UnfreezeBlock(stream, "RAM", Memory.RAM, sizeof(Memory.RAM));
+			else
+				result = UnfreezeBlockCopy(stream, "RAM", &local_ram, sizeof(Memory.RAM));
+			if (result != SUCCESS)
+				break;
 
-		if (fast)
-			result = UnfreezeBlock(stream, "SRA", Memory.SRAM, Memory.SRAM_SIZE);
-		else
-			result = UnfreezeBlockCopy (stream, "SRA", &local_sram, Memory.SRAM_SIZE);
-		if (result != SUCCESS)
-			break;
+			if (fast)
+				result = UnfreezeBlock(stream, "SRA", Memory.SRAM, Memory.SRAM_SIZE);
+			else
+				result = UnfreezeBlockCopy (stream, "SRA", &local_sram, Memory.SRAM_SIZE);
+			if (result != SUCCESS)
+				break;
+		}
 
 		if (fast)
 			result = UnfreezeBlock(stream, "FIL", Memory.FillRAM, 0x8000);
@@ -1412,7 +1561,11 @@ int S9xUnfreezeFromStream (STREAM stream)
 		if (result != SUCCESS)
 			break;
 
-		result = UnfreezeBlockCopy (stream, "SND", &local_apu_sound, SPC_SAVE_STATE_BLOCK_SIZE);
+		// the APU comes back from golden_apu, without staging 64KB of APU RAM
+		if (golden_restoring)
+			SkipBlockWithName(stream, "SND");
+		else
+			result = UnfreezeBlockCopy (stream, "SND", &local_apu_sound, SPC_SAVE_STATE_BLOCK_SIZE);
 		if (result != SUCCESS)
 			break;
 
@@ -1576,7 +1729,9 @@ int S9xUnfreezeFromStream (STREAM stream)
 		if (local_fillram)
 			memcpy(Memory.FillRAM, local_fillram, 0x8000);
 
-        if (version < SNAPSHOT_VERSION_BAPU)
+        if (golden_restoring)
+            S9xAPURestoreGolden(golden_apu);
+        else if (version < SNAPSHOT_VERSION_BAPU)
         {
             printf("Using Blargg APU snapshot loading (snapshot version %d, current is %d)\n...", version, SNAPSHOT_VERSION);
             S9xAPULoadBlarggState(local_apu_sound);
@@ -1733,6 +1888,7 @@ int S9xUnfreezeFromStream (STREAM stream)
 		{
 			GSU.pfPlot = fx_PlotTable[GSU.vMode];
 			GSU.pfRpix = fx_PlotTable[GSU.vMode + 5];
+			S9xSuperFXPostLoadState();
 		}
 
 		if (local_sa1 && local_sa1_registers)
@@ -1821,33 +1977,36 @@ int S9xUnfreezeFromStream (STREAM stream)
 		}
 	}
 
-	if (local_cpu)				delete [] local_cpu;
-	if (local_registers)		delete [] local_registers;
-	if (local_ppu)				delete [] local_ppu;
-	if (local_dma)				delete [] local_dma;
-	if (local_vram)				delete [] local_vram;
-	if (local_ram)				delete [] local_ram;
-	if (local_sram)				delete [] local_sram;
-	if (local_fillram)			delete [] local_fillram;
-	if (local_apu_sound)		delete [] local_apu_sound;
-	if (local_control_data)		delete [] local_control_data;
-	if (local_timing_data)		delete [] local_timing_data;
-	if (local_superfx)			delete [] local_superfx;
-	if (local_sa1)				delete [] local_sa1;
-	if (local_sa1_registers)	delete [] local_sa1_registers;
-	if (local_dsp1)				delete [] local_dsp1;
-	if (local_dsp2)				delete [] local_dsp2;
-	if (local_dsp4)				delete [] local_dsp4;
-	if (local_cx4_data)			delete [] local_cx4_data;
-	if (local_st010)			delete [] local_st010;
-	if (local_obc1)				delete [] local_obc1;
-	if (local_obc1_data)		delete [] local_obc1_data;
-	if (local_spc7110)			delete [] local_spc7110;
-	if (local_srtc)				delete [] local_srtc;
-	if (local_rtc_data)			delete [] local_rtc_data;
-	if (local_bsx_data)			delete [] local_bsx_data;
-	if (local_screenshot)		delete [] local_screenshot;
-	if (local_movie_data)		delete [] local_movie_data;
+	UnfreezeFree(local_cpu);
+	UnfreezeFree(local_registers);
+	UnfreezeFree(local_ppu);
+	UnfreezeFree(local_dma);
+	UnfreezeFree(local_vram);
+	UnfreezeFree(local_ram);
+	UnfreezeFree(local_sram);
+	UnfreezeFree(local_fillram);
+	UnfreezeFree(local_apu_sound);
+	UnfreezeFree(local_control_data);
+	UnfreezeFree(local_timing_data);
+	UnfreezeFree(local_superfx);
+	UnfreezeFree(local_sa1);
+	UnfreezeFree(local_sa1_registers);
+	UnfreezeFree(local_dsp1);
+	UnfreezeFree(local_dsp2);
+	UnfreezeFree(local_dsp4);
+	UnfreezeFree(local_cx4_data);
+	UnfreezeFree(local_st010);
+	UnfreezeFree(local_obc1);
+	UnfreezeFree(local_obc1_data);
+	UnfreezeFree(local_spc7110);
+	UnfreezeFree(local_srtc);
+	UnfreezeFree(local_rtc_data);
+	UnfreezeFree(local_bsx_data);
+	UnfreezeFree(local_msu1_data);
+	UnfreezeFree(local_screenshot);
+	UnfreezeFree(local_movie_data);
+
+	native_fields = FALSE;
 
 	return (result);
 }
@@ -1937,11 +2096,132 @@ int S9xUnfreezeScreenshotFromStream(STREAM stream, uint16 **image_buffer, int &w
         delete ssi;
     }
 
-    if(local_screenshot)		delete[] local_screenshot;
+    UnfreezeFree(local_screenshot);
 
     return (result);
 }
 
+static uint8 * FreezeScratch (int size)
+{
+	if (size > freeze_scratch_size)
+	{
+		delete [] freeze_scratch;
+		freeze_scratch = new uint8[size];
+		freeze_scratch_size = size;
+	}
+
+	return (freeze_scratch);
+}
+
+// While loading a fast savestate the blocks come out of one pool, which is grown between
+// loads to what the previous load needed; anything that doesn't fit goes to the heap
+static uint8 * UnfreezeAlloc (int size)
+{
+	if (Settings.FastSavestates)
+	{
+		unfreeze_pool_wanted += size;
+
+		if (unfreeze_pool_used + size <= unfreeze_pool_size)
+		{
+			uint8	*block = unfreeze_pool + unfreeze_pool_used;
+			unfreeze_pool_used += size;
+			return (block);
+		}
+	}
+
+	return (new uint8[size]);
+}
+
+static void UnfreezeFree (uint8 *block)
+{
+	if (block && (block < unfreeze_pool || block >= unfreeze_pool + unfreeze_pool_size))
+		delete [] block;
+}
+
+static void UnfreezePoolReset (void)
+{
+	if (unfreeze_pool_wanted > unfreeze_pool_size)
+	{
+		delete [] unfreeze_pool;
+		unfreeze_pool = new uint8[unfreeze_pool_wanted];
+		unfreeze_pool_size = unfreeze_pool_wanted;
+	}
+
+	unfreeze_pool_used = unfreeze_pool_wanted = 0;
+}
+
+// In host byte order a struct is saved as a handful of runs of adjacent fields, so fast
+// savestates walk a short list of runs instead of the FreezeData table, which for the PPU
+// alone is over a thousand entries. Tables with pointer fields have no plan.
+struct NativeRun
+{
+	int	offset;
+	int	size;
+};
+
+struct NativePlan
+{
+	FreezeData	*fields;
+	NativeRun	*runs;
+	int			num_runs;
+};
+
+static const NativePlan * NativePlanFor (FreezeData *fields, int num_fields)
+{
+	static NativePlan	plans[32];
+	static int			num_plans = 0;
+
+	for (int p = 0; p < num_plans; p++)
+	{
+		if (plans[p].fields == fields)
+			return (plans[p].runs ? &plans[p] : NULL);
+	}
+
+	if (num_plans == (int) COUNT(plans))
+		return (NULL);
+
+	NativePlan	*plan = &plans[num_plans++];
+	NativeRun	*runs = new NativeRun[num_fields];
+	int			n = 0;
+
+	plan->fields = fields;
+	plan->runs = NULL;
+
+	for (int i = 0; i < num_fields; i++)
+	{
+		if (SNAPSHOT_VERSION < fields[i].debuted_in || SNAPSHOT_VERSION >= fields[i].deleted_in)
+			continue;
+
+		if (fields[i].type >= uint8_INDIR_ARRAY_V || fields[i].offset < 0)
+		{
+			delete [] runs;
+			return (NULL);
+		}
+
+		int	size = FreezeSize(fields[i].size, fields[i].type);
+
+		if (n && runs[n - 1].offset + runs[n - 1].size == fields[i].offset)
+			runs[n - 1].size += size;
+		else
+		{
+			runs[n].offset = fields[i].offset;
+			runs[n].size = size;
+			n++;
+		}
+	}
+
+	plan->runs = runs;
+	plan->num_runs = n;
+
+	return (plan);
+}
+
+static void FreezeDigits (char *buffer, int value, int count)
+{
+	for (int i = count - 1; i >= 0; i--, value /= 10)
+		buffer[i] = '0' + value % 10;
+}
+
 static int FreezeSize (int size, int type)
 {
 	switch (type)
@@ -1976,8 +2256,22 @@ static void FreezeStruct (STREAM stream, const char *name, void *base, FreezeDat
 			len += FreezeSize(fields[i].size, fields[i].type);
 	}
 
-	uint8	*block = new uint8[len];
-	uint8	*ptr = block;
+	uint8				*block = FreezeScratch(len);
+	uint8				*ptr = block;
+	const NativePlan	*plan = native_fields ? NativePlanFor(fields, num_fields) : NULL;
+
+	if (plan)
+	{
+		for (i = 0; i < plan->num_runs; i++)
+		{
+			memcpy(ptr, (uint8 *) base + plan->runs[i].offset, plan->runs[i].size);
+			ptr += plan->runs[i].size;
+		}
+
+		FreezeBlock(stream, name, block, len);
+		return;
+	}
+
 	uint8	*addr;
 	uint16	word;
 	uint32	dword;
@@ -2005,6 +2299,15 @@ static void FreezeStruct (STREAM stream, const char *name, void *base, FreezeDat
 			addr = (uint8 *) &relativeAddr;
 		}
 
+		if (native_fields)
+		{
+			int	size = FreezeSize(fields[i].size, fields[i].type);
+
+			memcpy(ptr, addr, size);
+			ptr += size;
+			continue;
+		}
+
 		switch (fields[i].type)
 		{
 			case INT_V:
@@ -2078,26 +2381,29 @@ static void FreezeStruct (STREAM stream, const char *name, void *base, FreezeDat
 	}
 
 	FreezeBlock(stream, name, block, len);
-	delete [] block;
 }
 
 static void FreezeBlock (STREAM stream, const char *name, uint8 *block, int size)
 {
 	char	buffer[20];
 
+	memcpy(buffer, name, 3);
+	buffer[3] = ':';
+
 	// check if it fits in 6 digits. (letting it go over and using strlen isn't safe)
 	if (size <= 999999)
-		sprintf(buffer, "%s:%06d:", name, size);
+		FreezeDigits(buffer + 4, size, 6);
 	else
 	{
 		// to make it fit, pack it in the bytes instead of as digits
-		sprintf(buffer, "%s:------:", name);
+		buffer[4] = buffer[5] = '-';
 		buffer[6] = (unsigned char) ((unsigned) size >> 24);
 		buffer[7] = (unsigned char) ((unsigned) size >> 16);
 		buffer[8] = (unsigned char) ((unsigned) size >> 8);
 		buffer[9] = (unsigned char) ((unsigned) size >> 0);
 	}
 
+	buffer[10] = ':';
 	buffer[11] = 0;
 
 	WRITE_STREAM(buffer, 11, stream);
@@ -2223,12 +2529,12 @@ static int UnfreezeBlockCopy (STREAM stream, const char *name, uint8 **block, in
 		return 0;
 	}
 
-	*block = new uint8[size];
+	*block = UnfreezeAlloc(size);
 
 	result = UnfreezeBlock(stream, name, *block, size);
 	if (result != SUCCESS)
 	{
-		delete [] (*block);
+		UnfreezeFree(*block);
 		*block = NULL;
 		return (result);
 	}
@@ -2244,13 +2550,12 @@ static int UnfreezeStruct (STREAM stream, const char *name, void *base, FreezeDa
 	result = UnfreezeStructCopy(stream, name, &block, fields, num_fields, version);
 	if (result != SUCCESS)
 	{
-		if (block != NULL)
-			delete [] block;
+		UnfreezeFree(block);
 		return (result);
 	}
 
 	UnfreezeStructFromCopy(base, fields, num_fields, block, version);
-	delete [] block;
+	UnfreezeFree(block);
 
 	return (SUCCESS);
 }
@@ -2279,6 +2584,19 @@ static void UnfreezeStructFromCopy (void *sbase, FreezeData *fields, int num_fie
 	int		relativeAddr;
 	int		i, j;
 
+	const NativePlan	*plan = (native_fields && version == SNAPSHOT_VERSION) ? NativePlanFor(fields, num_fields) : NULL;
+
+	if (plan)
+	{
+		for (i = 0; i < plan->num_runs; i++)
+		{
+			memcpy((uint8 *) sbase + plan->runs[i].offset, ptr, plan->runs[i].size);
+			ptr += plan->runs[i].size;
+		}
+
+		return;
+	}
+
 	for (i = 0; i < num_fields; i++)
 	{
 		if (version < fields[i].debuted_in || version >= fields[i].deleted_in)
@@ -2290,6 +2608,15 @@ static void UnfreezeStructFromCopy (void *sbase, FreezeData *fields, int num_fie
 		if (fields[i].type == uint8_INDIR_ARRAY_V || fields[i].type == uint16_INDIR_ARRAY_V || fields[i].type == uint32_INDIR_ARRAY_V)
 			addr = (uint8 *) (*((pint *) addr));
 
+		if (native_fields)
+		{
+			int	size = FreezeSize(fields[i].size, fields[i].type);
+
+			if (fields[i].offset >= 0)
+				memcpy(addr, ptr, size);
+			ptr += size;
+		}
+		else
 		switch (fields[i].type)
 		{
 			case INT_V:
@@ -2410,3 +2737,168 @@ static void UnfreezeStructFromCopy (void *sbase, FreezeData *fields, int num_fie
 		}
 	}
 }
+
+static const struct
+{
+	const char	*block;
+	FreezeData	*fields;
+	int			num_fields;
+}	DiffTables[] =
+{
+	{ "CPU", SnapCPU,          COUNT(SnapCPU)          },
+	{ "REG", SnapRegisters,    COUNT(SnapRegisters)    },
+	{ "PPU", SnapPPU,          COUNT(SnapPPU)          },
+	{ "DMA", SnapDMA,          COUNT(SnapDMA)          },
+	{ "CTL", SnapControls,     COUNT(SnapControls)     },
+	{ "TIM", SnapTimings,      COUNT(SnapTimings)      },
+	{ "SFX", SnapFX,           COUNT(SnapFX)           },
+	{ "SA1", SnapSA1,          COUNT(SnapSA1)          },
+	{ "SAR", SnapSA1Registers, COUNT(SnapSA1Registers) },
+	{ "DP1", SnapDSP1,         COUNT(SnapDSP1)         },
+	{ "DP2", SnapDSP2,         COUNT(SnapDSP2)         },
+	{ "DP4", SnapDSP4,         COUNT(SnapDSP4)         },
+	{ "ST0", SnapST010,        COUNT(SnapST010)        },
+	{ "OBC", SnapOBC1,         COUNT(SnapOBC1)         },
+	{ "S71", SnapSPC7110Snap,  COUNT(SnapSPC7110Snap)  },
+	{ "SRT", SnapSRTCSnap,     COUNT(SnapSRTCSnap)     },
+	{ "BSX", SnapBSX,          COUNT(SnapBSX)          },
+	{ "MSU", SnapMSU1,         COUNT(SnapMSU1)         },
+	{ "SHO", SnapScreenshot,   COUNT(SnapScreenshot)   },
+	{ "MOV", SnapMovie,        COUNT(SnapMovie)        }
+};
+
+// Reads the 11-byte header of the block at buf[pos], same encoding as FreezeBlock
+static bool DiffBlockHeader (const uint8 *buf, uint32 size, uint32 pos, char *name, uint32 &len)
+{
+	if (pos + 11 > size || buf[pos + 3] != ':')
+		return (false);
+
+	memcpy(name, buf + pos, 3);
+	name[3] = 0;
+
+	if (buf[pos + 4] == '-')
+		len = (buf[pos + 6] << 24) | (buf[pos + 7] << 16) | (buf[pos + 8] << 8) | buf[pos + 9];
+	else
+	{
+		char	digits[7];
+		memcpy(digits, buf + pos + 4, 6);
+		digits[6] = 0;
+		len = atoi(digits);
+	}
+
+	return (pos + 11 + len <= size);
+}
+
+// Reports one run of differing bytes per report() call, returns the number of runs
+static int DiffBytes (const char *block, const char *field, int base, const uint8 *a, const uint8 *b, int len, S9xSnapshotDiffReport report)
+{
+	int	runs = 0;
+
+	for (int i = 0; i < len; i++)
+	{
+		if (a[i] == b[i])
+			continue;
+
+		int	start = i;
+		while (i < len && a[i] != b[i])
+			i++;
+
+		report(block, field, base + start, i - start);
+		runs++;
+	}
+
+	return (runs);
+}
+
+// Compares two snapshots made by S9xFreezeGameMem. Blocks that have a FreezeData table
+// are compared field by field, everything else (RAM, VRAM, sound...) as byte ranges.
+int S9xSnapshotDiff (const uint8 *a, uint32 a_size, const uint8 *b, uint32 b_size, S9xSnapshotDiffReport report)
+{
+	int		version, diffs = 0;
+	size_t	magic = strlen(SNAPSHOT_MAGIC);
+
+	if (a_size < magic + 6 || b_size < magic + 6 || memcmp(a, SNAPSHOT_MAGIC, magic) || memcmp(b, SNAPSHOT_MAGIC, magic))
+		return (-1);
+
+	if (memcmp(a, b, magic + 6))
+	{
+		report("HDR", NULL, 0, magic + 6);
+		return (1);
+	}
+
+	version = atoi((const char *) a + magic + 1);
+
+	uint32	apos = magic + 6, bpos = magic + 6;
+	char	aname[4], bname[4];
+	uint32	alen, blen;
+
+	while (DiffBlockHeader(a, a_size, apos, aname, alen) && DiffBlockHeader(b, b_size, bpos, bname, blen))
+	{
+		const uint8	*ablock = a + apos + 11;
+		const uint8	*bblock = b + bpos + 11;
+
+		if (strcmp(aname, bname))
+		{
+			report(aname, NULL, 0, alen);
+			return (diffs + 1);
+		}
+
+		apos += 11 + alen;
+		bpos += 11 + blen;
+
+		if (alen != blen)
+		{
+			report(aname, NULL, 0, alen > blen ? alen : blen);
+			diffs++;
+			continue;
+		}
+
+		if (!memcmp(ablock, bblock, alen))
+			continue;
+
+		int	t;
+		for (t = 0; t < (int) COUNT(DiffTables); t++)
+			if (!strcmp(DiffTables[t].block, aname))
+				break;
+
+		if (t == (int) COUNT(DiffTables))
+		{
+			diffs += DiffBytes(aname, NULL, 0, ablock, bblock, alen, report);
+			continue;
+		}
+
+		FreezeData	*fields = DiffTables[t].fields;
+		int			offset = 0;
+
+		for (int i = 0; i < DiffTables[t].num_fields && offset < (int) alen; i++)
+		{
+			if (version >= fields[i].deleted_in || version < fields[i].debuted_in)
+				continue;
+
+			int	len = FreezeSize(fields[i].size, fields[i].type);
+			if (offset + len > (int) alen)
+				len = alen - offset;
+
+			if (memcmp(ablock + offset, bblock + offset, len))
+			{
+				if (fields[i].type == INT_V || fields[i].type == POINTER_V)
+				{
+					report(aname, fields[i].name, offset, len);
+					diffs++;
+				}
+				else
+					diffs += DiffBytes(aname, fields[i].name, offset, ablock + offset, bblock + offset, len, report);
+			}
+
+			offset += len;
+		}
+	}
+
+	if (apos != a_size || bpos != b_size)
+	{
+		report("END", NULL, apos, a_size > b_size ? a_size - apos : b_size - bpos);
+		diffs++;
+	}
+
+	return (diffs);
+}
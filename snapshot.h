@@ -10,6 +10,7 @@
 #include "snes9x.h"
 
 #define SNAPSHOT_MAGIC			"#!s9xsnp"
+#define SNAPSHOT_FAST_MAGIC		"#!s9xfst"	// Settings.FastSavestates: host byte order, never leaves the process
 #define SNAPSHOT_VERSION_IRQ		7
 #define SNAPSHOT_VERSION_BAPU		8
 #define SNAPSHOT_VERSION_IRQ_2018	11		// irq changes were introduced earlier, since this we store NextIRQTimer directly
@@ -31,7 +32,18 @@ bool8 S9xUnfreezeGame (const char *);
 int S9xUnfreezeGameMem (const uint8 *,uint32);
 void S9xFreezeToStream (STREAM);
 int	 S9xUnfreezeFromStream (STREAM);
+// Fast reset for run-ahead, training loops and the like: capture a golden state once, then
+// restore it as often as needed. A restore costs about as much as the pages of RAM, VRAM,
+// SRAM and APU RAM written since the last capture or restore; it fails once another ROM is loaded.
+bool8 S9xCaptureGoldenState (void);
+bool8 S9xRestoreGoldenState (void);
+void S9xReleaseGoldenState (void);
 bool8 S9xUnfreezeScreenshot(const char *filename, uint16 **image_buffer, int &width, int &height);
 int S9xUnfreezeScreenshotFromStream(STREAM stream, uint16 **image_buffer, int &width, int &height);
 
+// block is the 3-letter snapshot block name, field is NULL for blocks without a FreezeData table;
+// offset and count are in bytes within the serialized block
+typedef void (*S9xSnapshotDiffReport) (const char *block, const char *field, int offset, int count);
+int S9xSnapshotDiff (const uint8 *, uint32, const uint8 *, uint32, S9xSnapshotDiffReport);
+
 #endif
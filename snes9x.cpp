@@ -232,6 +232,9 @@ void S9xLoadConfigFiles (char **argv, int argc)
 	Settings.DynamicRateControl         =  conf.GetBool("Sound::DynamicRateControl",           false);
 	Settings.DynamicRateLimit           =  conf.GetInt ("Sound::DynamicRateLimit",             5);
 	Settings.InterpolationMethod        =  conf.GetInt ("Sound::InterpolationMethod",          2);
+	Settings.SkipSMPIdleLoops           =  conf.GetBool("Sound::SkipSMPIdleLoops",             true);
+	Settings.StepSMPOpcodes             =  conf.GetBool("Sound::StepSMPOpcodes",               false);
+	Settings.FastDSP                    =  conf.GetBool("Sound::FastDSP",                      true);
 
 	// Display
 
@@ -240,6 +243,7 @@ void S9xLoadConfigFiles (char **argv, int argc)
 	Settings.DisplayTime				=  conf.GetBool("Display::DisplayTime",                false);
 	Settings.DisplayFrameRate           =  conf.GetBool("Display::DisplayFrameRate",           false);
 	Settings.DisplayWatchedAddresses    =  conf.GetBool("Display::DisplayWatchedAddresses",    false);
+	Settings.DisplayPerfCounters        =  conf.GetBool("Display::DisplayPerfCounters",        false);
 	Settings.DisplayPressedKeys         =  conf.GetBool("Display::DisplayInput",               false);
 	Settings.DisplayMovieFrame          =  conf.GetBool("Display::DisplayFrameCount",          false);
 	Settings.AutoDisplayMessages        =  conf.GetBool("Display::MessagesInImage",            true);
@@ -296,6 +300,7 @@ void S9xLoadConfigFiles (char **argv, int argc)
 
 	// Hack
 	Settings.SuperFXClockMultiplier         = conf.GetUInt("Hack::SuperFXClockMultiplier", 100);
+	Settings.SuperFXCycleCosts              = conf.GetBool("Hack::SuperFXCycleCosts", false);
     Settings.OverclockMode                  = conf.GetUInt("Hack::OverclockMode", 0);
     Settings.SeparateEchoBuffer             = conf.GetBool("Hack::SeparateEchoBuffer", false);
 	Settings.DisableGameSpecificHacks       = !conf.GetBool("Hack::EnableGameSpecificHacks",       true);
@@ -358,6 +363,7 @@ void S9xUsage (void)
 	// DISPLAY OPTIONS
 	S9xMessage(S9X_INFO, S9X_USAGE, "-displaytime                    Display the time");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-displayframerate               Display the frame rate counter");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-displayperfcounters            Display per-frame performance counters");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-displaykeypress                Display input of all controllers and peripherals");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-nohires                        (Not recommended) Disable support for hi-res and");
 	S9xMessage(S9X_INFO, S9X_USAGE, "                                interlace modes");
@@ -534,6 +540,9 @@ char * S9xParseArgs (char **argv, int argc)
 			if (!strcasecmp(argv[i], "-displayframerate"))
 				Settings.DisplayFrameRate = TRUE;
 			else
+			if (!strcasecmp(argv[i], "-displayperfcounters"))
+				Settings.DisplayPerfCounters = TRUE;
+			else
 			if (!strcasecmp(argv[i], "-displaykeypress"))
 				Settings.DisplayPressedKeys = TRUE;
 			else
@@ -243,6 +243,9 @@ struct SSettings
 	bool8	DynamicRateControl;
 	int32	DynamicRateLimit; /* Multiplied by 1000 */
 	int32	InterpolationMethod;
+	bool8	SkipSMPIdleLoops;
+	bool8	StepSMPOpcodes;
+	bool8	FastDSP;
 
 	bool8	Transparency;
 	uint8	BG_Forced;
@@ -252,10 +255,12 @@ struct SSettings
 	bool8	DisplayTime;
 	bool8	DisplayFrameRate;
 	bool8	DisplayWatchedAddresses;
+	bool8	DisplayPerfCounters;
 	bool8	DisplayPressedKeys;
 	bool8	DisplayMovieFrame;
 	bool	DisplayIndicators;
 	bool8	AutoDisplayMessages;
+	bool8	MessagesAsOverlay;
 	uint32	InitialInfoStringTimeout;
 	uint16	DisplayColor;
 	bool8	BilinearFilter;
@@ -292,6 +297,7 @@ struct SSettings
 	bool8	WrongMovieStateProtection;
 	bool8	DumpStreams;
 	int		DumpStreamsMaxFrames;
+	bool8	CodeCoverage;
 
 	bool8	TakeScreenshot;
 	int8	StretchScreenshots;
@@ -309,6 +315,7 @@ struct SSettings
 
     bool8   SeparateEchoBuffer;
 	uint32	SuperFXClockMultiplier;
+	bool8	SuperFXCycleCosts;
     int OverclockMode;
 	int	OneClockCycle;
 	int	OneSlowClockCycle;
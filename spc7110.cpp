@@ -71,6 +71,10 @@ static void SetSPC7110SRAMMap (uint8 newstate)
 		Memory.Map[0x306] = (uint8 *) Memory.MAP_RONLY_SRAM;
 		Memory.Map[0x307] = (uint8 *) Memory.MAP_RONLY_SRAM;
 	}
+
+#ifdef DEBUGGER
+	S9xRefreshWatchpoints();
+#endif
 }
 
 uint8 * S9xGetBasePointerSPC7110 (uint32 address)
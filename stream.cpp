@@ -148,47 +148,197 @@ void fStream::closeStream()
 
 unzStream::unzStream (unzFile &v)
 {
+	unz_file_info	info;
+
 	file = v;
-    pos_in_buf = 0;
-    buf_pos_in_unzipped = unztell(file);
-    bytes_in_buf = 0;
+	at_end = false;
+	in_buf.resize(unz_MAXBUFFSIZ);
+	memset(&zs, 0, sizeof(zs));
+
+	// remember start pos for seeks
+	unzGetFilePos(file, &unz_file_start_pos);
+
+	unzGetCurrentFileInfo(file, &info, NULL, 0, NULL, 0, NULL, 0);
+	inflating = (info.compression_method == Z_DEFLATED && inflateInit2(&zs, -MAX_WBITS) == Z_OK);
 
-    // remember start pos for seeks
-    unzGetFilePos(file, &unz_file_start_pos);
+	open_entry();
 }
 
 unzStream::~unzStream (void)
 {
-	return;
+	if (inflating)
+		inflateEnd(&zs);
 }
 
-size_t unzStream::buffer_remaining()
+// Opens the entry at its start; deflated entries in raw mode
+bool unzStream::open_entry (void)
 {
-    return bytes_in_buf - pos_in_buf;
+	unzGoToFilePos(file, &unz_file_start_pos);
+
+	if ((inflating ? unzOpenCurrentFile2(file, NULL, NULL, 1) : unzOpenCurrentFile(file)) != UNZ_OK)
+	{
+		at_end = true;
+		return (false);
+	}
+
+	if (inflating)
+	{
+		inflateReset(&zs);
+		zs.avail_in = 0;
+	}
+
+	in_chunk = unz_BUFFSIZ;
+	in_total = 0;
+	out_total = 0;
+	read_pos = 0;
+	at_end = false;
+
+	return (true);
 }
 
-void unzStream::fill_buffer()
+// Continues inflating from a checkpoint, or from the start if there is none
+bool unzStream::restart (const unz_checkpoint *cp)
 {
-    buf_pos_in_unzipped = unztell(file);
-    bytes_in_buf = unzReadCurrentFile(file, buffer, unz_BUFFSIZ);
-    pos_in_buf = 0;
+	if (!open_entry())
+		return (false);
+	if (!cp)
+		return (true);
+
+	// minizip can't seek within an entry, but skipping compressed data is
+	// far cheaper than inflating it
+	size_t	skip = cp->in - (cp->bits ? 1 : 0);
+
+	while (skip)
+	{
+		int	n = unzReadCurrentFile(file, &in_buf[0], (unsigned) (skip < in_buf.size() ? skip : in_buf.size()));
+		if (n <= 0)
+		{
+			at_end = true;
+			return (false);
+		}
+
+		skip -= n;
+		in_total += n;
+	}
+
+	if (cp->bits)
+	{
+		uint8	c;
+
+		if (unzReadCurrentFile(file, &c, 1) != 1)
+		{
+			at_end = true;
+			return (false);
+		}
+
+		in_total++;
+		inflatePrime(&zs, cp->bits, c >> (8 - cp->bits));
+	}
+
+	inflateSetDictionary(&zs, &cp->window[0], unz_WINSIZE);
+
+	// the window lines up with the position as if it had just been inflated
+	size_t	at = cp->out % unz_WINSIZE;
+	memcpy(window + at, &cp->window[0], unz_WINSIZE - at);
+	memcpy(window, &cp->window[unz_WINSIZE - at], at);
+
+	out_total = read_pos = cp->out;
+
+	return (true);
 }
 
-int unzStream::get_char (void)
+bool unzStream::fill_input (void)
 {
-	unsigned char	c;
+	int	n = unzReadCurrentFile(file, &in_buf[0], (unsigned) in_chunk);
+	if (n <= 0)
+		return (false);
+
+	zs.next_in = &in_buf[0];
+	zs.avail_in = n;
+	in_total += n;
+
+	if (in_chunk < unz_MAXBUFFSIZ)
+		in_chunk *= 2;
 
-	if (buffer_remaining() <= 0)
+	return (true);
+}
+
+void unzStream::add_checkpoint (void)
+{
+	if (out_total < (checkpoints.empty() ? 0 : checkpoints.back().out) + unz_SPAN)
+		return;
+
+	unz_checkpoint	cp;
+	size_t			at = out_total % unz_WINSIZE;
+
+	cp.in = in_total - zs.avail_in;
+	cp.out = out_total;
+	cp.bits = zs.data_type & 7;
+	cp.window.resize(unz_WINSIZE);
+	memcpy(&cp.window[0], window + at, unz_WINSIZE - at);
+	memcpy(&cp.window[unz_WINSIZE - at], window, at);
+
+	checkpoints.push_back(std::move(cp));
+}
+
+// Adds output up to the end of the window, returns how much
+size_t unzStream::produce (void)
+{
+	size_t	at = out_total % unz_WINSIZE;
+	size_t	room = unz_WINSIZE - at;
+
+	if (at_end)
+		return (0);
+
+	if (!inflating)
 	{
-        fill_buffer();
-		if (bytes_in_buf <= 0)
-			return (EOF);
+		int	n = unzReadCurrentFile(file, window + at, (unsigned) room);
+		if (n <= 0)
+		{
+			at_end = true;
+			return (0);
+		}
+
+		out_total += n;
+		return (n);
 	}
 
-	c = *(buffer + pos_in_buf);
-    pos_in_buf++;
+	zs.next_out = window + at;
+	zs.avail_out = (uInt) room;
 
-	return ((int) c);
+	do
+	{
+		if (!zs.avail_in && !fill_input())
+		{
+			at_end = true;
+			break;
+		}
+
+		uInt	before = zs.avail_out;
+		int		ret = inflate(&zs, Z_BLOCK);
+
+		out_total += before - zs.avail_out;
+
+		if (ret != Z_OK && ret != Z_BUF_ERROR)
+		{
+			at_end = true;
+			break;
+		}
+
+		// between two blocks, and not after the last one
+		if ((zs.data_type & 128) && !(zs.data_type & 64))
+			add_checkpoint();
+	} while (zs.avail_out);
+
+	return (room - zs.avail_out);
+}
+
+int unzStream::get_char (void)
+{
+	if (read_pos == out_total && !produce())
+		return (EOF);
+
+	return ((int) window[read_pos++ % unz_WINSIZE]);
 }
 
 char * unzStream::gets (char *buf, size_t len)
@@ -218,28 +368,28 @@ char * unzStream::gets (char *buf, size_t len)
 
 size_t unzStream::read (void *buf, size_t len)
 {
-	if (len == 0)
-		return (len);
+	uint8	*read_to = (uint8 *) buf;
+	size_t	done = 0;
 
-	size_t	to_read = len;
-    uint8 *read_to = (uint8 * )buf;
-    do
-    {
-        size_t in_buffer = buffer_remaining();
-        if (to_read <= in_buffer)
-        {
-            memcpy(read_to, buffer + pos_in_buf, to_read);
-            pos_in_buf += to_read;
-            to_read = 0;
-            break;
-        }
+	while (done < len)
+	{
+		if (read_pos == out_total && !produce())
+			break;
+
+		size_t	at = read_pos % unz_WINSIZE;
+		size_t	n = len - done;
 
-        memcpy(read_to, buffer + pos_in_buf, in_buffer);
-        to_read -= in_buffer;
-        fill_buffer();
-    } while (bytes_in_buf);
+		if (n > out_total - read_pos)
+			n = out_total - read_pos;
+		if (n > unz_WINSIZE - at)
+			n = unz_WINSIZE - at;
 
-	return (len - to_read);
+		memcpy(read_to + done, window + at, n);
+		read_pos += n;
+		done += n;
+	}
+
+	return (done);
 }
 
 // not supported
@@ -250,7 +400,7 @@ size_t unzStream::write (void *buf, size_t len)
 
 size_t unzStream::pos (void)
 {
-    return buf_pos_in_unzipped + pos_in_buf;
+    return (read_pos);
 }
 
 size_t unzStream::size (void)
@@ -262,25 +412,43 @@ size_t unzStream::size (void)
 
 int unzStream::revert (uint8 origin, int32 offset)
 {
-    size_t target_pos = pos_from_origin_offset(origin, offset);
+	size_t	target_pos = pos_from_origin_offset(origin, offset);
+	size_t	buffered = out_total < unz_WINSIZE ? out_total : unz_WINSIZE;
 
-    // new pos inside buffered data
-    if (target_pos >= buf_pos_in_unzipped && target_pos < buf_pos_in_unzipped + bytes_in_buf)
-    {
-        pos_in_buf = target_pos - buf_pos_in_unzipped;
-    }
-    else // outside of buffer, reset file and read until pos
-    {
-        unzGoToFilePos(file, &unz_file_start_pos);
-        unzOpenCurrentFile(file); // necessary to reopen after seek
-        int times_to_read = target_pos / unz_BUFFSIZ + 1;
-        for( int i = 0; i < times_to_read; i++)
-        {
-            fill_buffer();
-        }
-        pos_in_buf = target_pos % unz_BUFFSIZ;
-    }
-    return 0;
+	// new pos inside the window
+	if (target_pos <= out_total && target_pos >= out_total - buffered)
+	{
+		read_pos = target_pos;
+		return (0);
+	}
+
+	// resume from the last checkpoint before the target, unless going on
+	// from here is closer
+	const unz_checkpoint	*cp = NULL;
+
+	for (size_t i = checkpoints.size(); i-- > 0; )
+	{
+		if (checkpoints[i].out <= target_pos)
+		{
+			cp = &checkpoints[i];
+			break;
+		}
+	}
+
+	if (target_pos < out_total || (cp && cp->out > out_total))
+	{
+		if (!restart(cp))
+			return (-1);
+	}
+	else
+		in_chunk = unz_BUFFSIZ;
+
+	while (out_total < target_pos && produce())
+		;
+
+	read_pos = target_pos < out_total ? target_pos : out_total;
+
+	return (0);
 }
 
 void unzStream::closeStream()
@@ -298,6 +466,7 @@ memStream::memStream (uint8 *source, size_t sourceSize)
 	mem = head = source;
     msize = remaining = sourceSize;
     readonly = false;
+    full = false;
 }
 
 memStream::memStream (const uint8 *source, size_t sourceSize)
@@ -305,6 +474,7 @@ memStream::memStream (const uint8 *source, size_t sourceSize)
 	mem = head = const_cast<uint8 *>(source);
     msize = remaining = sourceSize;
     readonly = true;
+    full = false;
 }
 
 memStream::~memStream (void)
@@ -366,6 +536,9 @@ size_t memStream::write (void *buf, size_t len)
     head += bytes;
     remaining -= bytes;
 
+	if(bytes < len)
+		full = true;
+
 	return bytes;
 }
 
@@ -54,7 +54,23 @@ class fStream : public Stream
 #    include "unzip.h"
 #  endif
 
-#define unz_BUFFSIZ	1024
+#include <vector>
+
+// Deflated entries are inflated here rather than by minizip, so the inflater
+// state can be saved every unz_SPAN bytes of output (as in zlib's zran.c). A
+// seek then restarts from the nearest checkpoint instead of from the start.
+#define unz_WINSIZE		32768			// deflate window, also the read buffer
+#define unz_BUFFSIZ		4096			// compressed bytes read at a time after a seek,
+#define unz_MAXBUFFSIZ	65536			// doubling up to this while reading straight on
+#define unz_SPAN		(1024 * 1024)
+
+struct unz_checkpoint
+{
+	size_t	in;			// compressed bytes consumed
+	size_t	out;		// uncompressed position
+	int		bits;		// bits of the byte before `in` not consumed yet
+	std::vector<uint8>	window;
+};
 
 class unzStream : public Stream
 {
@@ -71,15 +87,24 @@ class unzStream : public Stream
         virtual void closeStream();
 
 	private:
-        void   fill_buffer();
-        size_t buffer_remaining();
+        bool   open_entry (void);
+        bool   restart (const unz_checkpoint *);
+        bool   fill_input (void);
+        size_t produce (void);
+        void   add_checkpoint (void);
 
 		unzFile	file;
-		char	buffer[unz_BUFFSIZ];
-        size_t  pos_in_buf;
-        size_t  buf_pos_in_unzipped;
-		size_t	bytes_in_buf;
         unz_file_pos unz_file_start_pos;
+        bool    inflating;      // deflated entry, inflated by this class
+        bool    at_end;
+        z_stream zs;
+        std::vector<uint8> in_buf;
+        size_t  in_chunk;
+        size_t  in_total;       // compressed bytes handed to inflate
+        uint8   window[unz_WINSIZE];
+        size_t  out_total;      // uncompressed bytes produced; the last unz_WINSIZE are in window
+        size_t  read_pos;
+        std::vector<unz_checkpoint> checkpoints;
 };
 
 #endif
@@ -98,6 +123,7 @@ class memStream : public Stream
         virtual size_t size (void);
         virtual int revert (uint8 origin, int32 offset);
         virtual void closeStream();
+        bool    overflowed (void) const { return full; }	// a write didn't fit
 
 	private:
 		uint8   *mem;
@@ -105,6 +131,7 @@ class memStream : public Stream
         size_t  remaining;
 		uint8	*head;
         bool    readonly;
+        bool    full;
 };
 
 /* dummy stream that always reads 0 and writes nowhere
@@ -10,6 +10,7 @@
 #include "snes9x.h"
 #include "ppu.h"
 #include "tile.h"
+#include "perfcounters.h"
 
 extern struct SLineMatrixData	LineMatrixData[240];
 
@@ -100,13 +101,19 @@ namespace TileImpl {
 			{
 				pCache = &BG.BufferFlip[TileNumber << 6];
 				if (!BG.BufferedFlip[TileNumber])
+				{
 					BG.BufferedFlip[TileNumber] = BG.ConvertTileFlip(pCache, TileAddr, Tile & 0x3ff);
+					S9xPerfAdd(PERF_TILE_MISSES, 1);
+				}
 			}
 			else
 			{
 				pCache = &BG.Buffer[TileNumber << 6];
 				if (!BG.Buffered[TileNumber])
+				{
 					BG.Buffered[TileNumber] = BG.ConvertTile(pCache, TileAddr, Tile & 0x3ff);
+					S9xPerfAdd(PERF_TILE_MISSES, 1);
+				}
 			}
 		}
 
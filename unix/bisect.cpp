@@ -0,0 +1,540 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+/*
+ * snes9x-bisect: runs the same savestate/movie under two core configurations
+ * and finds the first point where their emulated state diverges.
+ *
+ *   snes9x-bisect [-state file] [-movie file] [-frames n] -a Key=val -b Key=val rom
+ *
+ * Every frame both sides are started from the last common snapshot, run for one
+ * frame and compared with S9xFreezeGameMem. On the first mismatch, debugger
+ * builds replay that frame instruction by instruction to bisect down to the
+ * first differing scanline and then the first differing instruction.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <vector>
+#include "snes9x.h"
+#include "memmap.h"
+#include "apu/apu.h"
+#include "gfx.h"
+#include "snapshot.h"
+#include "controls.h"
+#include "movie.h"
+#include "display.h"
+#include "conffile.h"
+#include "fscompat.h"
+
+enum
+{
+	TOGGLE_BOOL,
+	TOGGLE_INT,
+	TOGGLE_UINT
+};
+
+struct SToggle
+{
+	const char	*name;
+	int			type;
+	void		*field;
+};
+
+// Settings that can be flipped between the two sides at run time
+static const SToggle	Toggles[] =
+{
+	{ "InterpolationMethod",          TOGGLE_INT,  &Settings.InterpolationMethod          },
+	{ "SeparateEchoBuffer",           TOGGLE_BOOL, &Settings.SeparateEchoBuffer           },
+	{ "SkipSMPIdleLoops",             TOGGLE_BOOL, &Settings.SkipSMPIdleLoops             },
+	{ "StepSMPOpcodes",               TOGGLE_BOOL, &Settings.StepSMPOpcodes               },
+	{ "FastDSP",                      TOGGLE_BOOL, &Settings.FastDSP                      },
+	{ "MaxSpriteTilesPerLine",        TOGGLE_INT,  &Settings.MaxSpriteTilesPerLine        },
+	{ "OneClockCycle",                TOGGLE_INT,  &Settings.OneClockCycle                },
+	{ "OneSlowClockCycle",            TOGGLE_INT,  &Settings.OneSlowClockCycle            },
+	{ "TwoClockCycles",               TOGGLE_INT,  &Settings.TwoClockCycles               },
+	{ "SuperFXClockMultiplier",       TOGGLE_UINT, &Settings.SuperFXClockMultiplier       },
+	{ "SuperFXCycleCosts",            TOGGLE_BOOL, &Settings.SuperFXCycleCosts            },
+	{ "HDMATimingHack",               TOGGLE_INT,  &Settings.HDMATimingHack               },
+	{ "BlockInvalidVRAMAccessMaster", TOGGLE_BOOL, &Settings.BlockInvalidVRAMAccessMaster },
+	{ "BlockInvalidVRAMAccess",       TOGGLE_BOOL, &Settings.BlockInvalidVRAMAccess       }
+};
+
+#define TOGGLE_COUNT	((int) (sizeof(Toggles) / sizeof(Toggles[0])))
+
+struct SSide
+{
+	std::vector<int>	toggle;
+	std::vector<long>	value;
+};
+
+static SSide				Side[2];
+static struct SSettings		BaseSettings;
+static std::vector<uint8>	Common, StateA, StateB;
+
+
+static void Usage (void)
+{
+	fprintf(stderr, "usage: snes9x-bisect [options] rom\n"
+					"  -state <file>      start from this savestate\n"
+					"  -movie <file>      play back this movie (read-only)\n"
+					"  -frames <n>        number of frames to compare (default 3600)\n"
+					"  -a <Key>=<value>   setting for side A, may be repeated\n"
+					"  -b <Key>=<value>   setting for side B, may be repeated\n"
+					"settings:\n");
+
+	for (int i = 0; i < TOGGLE_COUNT; i++)
+		fprintf(stderr, "  %s\n", Toggles[i].name);
+
+	exit(1);
+}
+
+static bool ParseToggle (SSide &side, const char *arg)
+{
+	const char	*eq = strchr(arg, '=');
+	if (!eq)
+		return (false);
+
+	for (int i = 0; i < TOGGLE_COUNT; i++)
+	{
+		if (strlen(Toggles[i].name) == (size_t) (eq - arg) && !strncasecmp(Toggles[i].name, arg, eq - arg))
+		{
+			const char	*v = eq + 1;
+			long		value;
+
+			if (!strcasecmp(v, "true") || !strcasecmp(v, "on"))
+				value = 1;
+			else
+			if (!strcasecmp(v, "false") || !strcasecmp(v, "off"))
+				value = 0;
+			else
+				value = strtol(v, NULL, 0);
+
+			side.toggle.push_back(i);
+			side.value.push_back(value);
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+static void ApplySide (const SSide &side)
+{
+	Settings = BaseSettings;
+
+	for (size_t i = 0; i < side.toggle.size(); i++)
+	{
+		const SToggle	&t = Toggles[side.toggle[i]];
+
+		switch (t.type)
+		{
+			case TOGGLE_BOOL:
+				*((bool8 *) t.field) = side.value[i] ? TRUE : FALSE;
+				break;
+
+			case TOGGLE_INT:
+				*((int32 *) t.field) = (int32) side.value[i];
+				break;
+
+			case TOGGLE_UINT:
+				*((uint32 *) t.field) = (uint32) side.value[i];
+				break;
+		}
+	}
+}
+
+static void Freeze (std::vector<uint8> &state)
+{
+#ifdef DEBUGGER
+	CPU.Flags &= ~(DEBUG_MODE_FLAG | SINGLE_STEP_FLAG);
+#endif
+	state.resize(S9xFreezeSize());
+	S9xFreezeGameMem(state.data(), state.size());
+}
+
+static void Restore (const SSide &side, const std::vector<uint8> &state)
+{
+	ApplySide(side);
+
+	if (S9xUnfreezeGameMem(state.data(), state.size()) != SUCCESS)
+	{
+		fprintf(stderr, "Failed to restore snapshot.\n");
+		exit(1);
+	}
+}
+
+static void RunFrame (void)
+{
+	do
+	{
+	#ifdef DEBUGGER
+		CPU.Flags &= ~(DEBUG_MODE_FLAG | SINGLE_STEP_FLAG);
+	#endif
+		S9xMainLoop();
+	} while (!(CPU.Flags & SCAN_KEYS_FLAG));
+
+	S9xClearSamples();
+}
+
+#ifdef DEBUGGER
+// Executes one instruction; false once the frame has ended
+static bool Step (void)
+{
+	CPU.Flags &= ~DEBUG_MODE_FLAG;
+	CPU.Flags |= SINGLE_STEP_FLAG;
+	S9xMainLoop();
+
+	return (!(CPU.Flags & SCAN_KEYS_FLAG));
+}
+
+// Steps to the first instruction boundary of the line'th scanline since the frame started
+static bool SkipLines (int line)
+{
+	int32	v = CPU.V_Counter;
+
+	for (int l = 0; l < line; )
+	{
+		if (!Step())
+			return (false);
+
+		if (CPU.V_Counter != v)
+		{
+			v = CPU.V_Counter;
+			l++;
+		}
+	}
+
+	return (true);
+}
+
+// Replays the frame from Common on one side up to a scanline plus some instructions
+static void RunTo (const SSide &side, int line, int steps, std::vector<uint8> &state)
+{
+	Restore(side, Common);
+
+	if (SkipLines(line))
+	{
+		for (int i = 0; i < steps; i++)
+			if (!Step())
+				break;
+	}
+
+	S9xClearSamples();
+	Freeze(state);
+}
+
+static bool Differs (int line, int steps)
+{
+	RunTo(Side[0], line, steps, StateA);
+	RunTo(Side[1], line, steps, StateB);
+
+	return (StateA != StateB);
+}
+#endif
+
+static void Report (const char *block, const char *field, int offset, int count)
+{
+	char	name[64];
+
+	snprintf(name, sizeof(name), field ? "%s.%s" : "%s", block, field);
+	printf("  %-36s +%06X  %d byte%s\n", name, offset, count, count == 1 ? "" : "s");
+}
+
+int main (int argc, char **argv)
+{
+	const char	*rom_filename = NULL, *state_filename = NULL, *movie_filename = NULL;
+	int			frames = 3600;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-state") && i + 1 < argc)
+			state_filename = argv[++i];
+		else
+		if (!strcmp(argv[i], "-movie") && i + 1 < argc)
+			movie_filename = argv[++i];
+		else
+		if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else
+		if ((!strcmp(argv[i], "-a") || !strcmp(argv[i], "-b")) && i + 1 < argc)
+		{
+			SSide	&side = Side[argv[i][1] == 'b'];
+			if (!ParseToggle(side, argv[++i]))
+			{
+				fprintf(stderr, "Unknown setting '%s'.\n", argv[i]);
+				Usage();
+			}
+		}
+		else
+		if (argv[i][0] != '-' && !rom_filename)
+			rom_filename = argv[i];
+		else
+			Usage();
+	}
+
+	if (!rom_filename)
+		Usage();
+
+	memset(&Settings, 0, sizeof(Settings));
+	Settings.MouseMaster = TRUE;
+	Settings.SuperScopeMaster = TRUE;
+	Settings.JustifierMaster = TRUE;
+	Settings.MultiPlayer5Master = TRUE;
+	Settings.FrameTimePAL = 20000;
+	Settings.FrameTimeNTSC = 16667;
+	Settings.SixteenBitSound = TRUE;
+	Settings.Stereo = TRUE;
+	Settings.SoundPlaybackRate = 32000;
+	Settings.SoundInputRate = 32000;
+	Settings.Transparency = TRUE;
+	Settings.HDMATimingHack = 100;
+	Settings.BlockInvalidVRAMAccessMaster = TRUE;
+	Settings.SuperFXClockMultiplier = 100;
+	Settings.MaxSpriteTilesPerLine = 34;
+	Settings.InterpolationMethod = DSP_INTERPOLATION_GAUSSIAN;
+	Settings.OneClockCycle = 6;
+	Settings.OneSlowClockCycle = 8;
+	Settings.TwoClockCycles = 12;
+	Settings.DumpStreamsMaxFrames = -1;
+	Settings.SkipFrames = 0;
+	CPU.Flags = 0;
+
+	if (!Memory.Init() || !S9xInitAPU())
+	{
+		fprintf(stderr, "Memory allocation failure.\n");
+		exit(1);
+	}
+
+	S9xInitSound(0);
+	S9xSetSoundMute(TRUE);
+	S9xGraphicsInit();
+	S9xSetController(0, CTL_JOYPAD, 0, 0, 0, 0);
+	S9xSetController(1, CTL_JOYPAD, 1, 0, 0, 0);
+
+	if (!Memory.LoadROM(rom_filename))
+	{
+		fprintf(stderr, "Error opening the ROM file.\n");
+		exit(1);
+	}
+
+	if (movie_filename)
+	{
+		if (S9xMovieOpen(movie_filename, TRUE) != SUCCESS)
+			exit(1);
+	}
+	else
+	if (state_filename && !S9xUnfreezeGame(state_filename))
+		exit(1);
+
+	BaseSettings = Settings;
+	BaseSettings.WrongMovieStateProtection = FALSE;
+	BaseSettings.SnapshotScreenshots = FALSE;
+	BaseSettings.StopEmulation = FALSE;
+	Settings = BaseSettings;
+
+	Freeze(Common);
+
+	int	frame;
+
+	for (frame = 0; frame < frames; frame++)
+	{
+		Restore(Side[0], Common);
+		RunFrame();
+		Freeze(StateA);
+
+		Restore(Side[1], Common);
+		RunFrame();
+		Freeze(StateB);
+
+		if (StateA != StateB)
+			break;
+
+		Common.swap(StateA);
+	}
+
+	if (frame == frames)
+	{
+		printf("No divergence in %d frames.\n", frames);
+		return (0);
+	}
+
+	printf("First divergence in frame %d.\n", frame);
+
+#ifdef DEBUGGER
+	// count the scanline starts of the frame on side A to bound the search
+	int	lines = 0;
+
+	Restore(Side[0], Common);
+	for (int32 v = CPU.V_Counter; Step(); )
+	{
+		if (CPU.V_Counter != v)
+		{
+			v = CPU.V_Counter;
+			lines++;
+		}
+	}
+
+	// states match at the start of scanline lo and differ at the start of hi (lines + 1 is the frame end)
+	int	lo = 0, hi = lines + 1;
+
+	while (hi - lo > 1)
+	{
+		int	mid = (lo + hi) / 2;
+
+		if (Differs(mid, 0))
+			hi = mid;
+		else
+			lo = mid;
+	}
+
+	// the same for the instructions of scanline lo, count + 1 steps reach the next line
+	int	count = 0;
+
+	Restore(Side[0], Common);
+	SkipLines(lo);
+	for (int32 v = CPU.V_Counter; Step() && CPU.V_Counter == v; )
+		count++;
+
+	int	first = 0, last = count + 1;
+
+	while (last - first > 1)
+	{
+		int	mid = (first + last) / 2;
+
+		if (Differs(lo, mid))
+			last = mid;
+		else
+			first = mid;
+	}
+
+	RunTo(Side[0], lo, first, StateA);
+	printf("First divergence on scanline %d of the frame (V=%d, H=%d), in instruction %d of that line at $%02X:%04X.\n",
+		lo, CPU.V_Counter, CPU.Cycles, first, Registers.PB, Registers.PCw);
+
+	Differs(lo, last);
+#else
+	printf("Rebuild with --enable-debugger to narrow this down to scanline and instruction.\n");
+#endif
+
+	printf("Differing fields:\n");
+	S9xSnapshotDiff(StateA.data(), StateA.size(), StateB.data(), StateB.size(), Report);
+
+	return (1);
+}
+
+// Routines a port has to provide, most of them unused without a display
+
+void S9xMessage (int type, int, const char *message)
+{
+	if (type >= S9X_WARNING)
+		fprintf(stderr, "%s\n", message);
+}
+
+void S9xExit (void)
+{
+	exit(1);
+}
+
+bool8 S9xInitUpdate (void)
+{
+	return (TRUE);
+}
+
+bool8 S9xDeinitUpdate (int, int)
+{
+	return (TRUE);
+}
+
+bool8 S9xContinueUpdate (int, int)
+{
+	return (TRUE);
+}
+
+void S9xSyncSpeed (void)
+{
+	IPPU.RenderThisFrame = FALSE;
+}
+
+void S9xAutoSaveSRAM (void)
+{
+}
+
+bool8 S9xOpenSoundDevice (void)
+{
+	return (TRUE);
+}
+
+void S9xToggleSoundChannel (int)
+{
+}
+
+void S9xTextMode (void)
+{
+}
+
+void S9xGraphicsMode (void)
+{
+}
+
+const char * S9xStringInput (const char *)
+{
+	return (NULL);
+}
+
+void S9xExtraUsage (void)
+{
+}
+
+void S9xParseArg (char **, int &, int)
+{
+}
+
+void S9xParsePortConfig (ConfigFile &, int)
+{
+}
+
+void S9xHandlePortCommand (s9xcommand_t, int16, int16)
+{
+}
+
+bool S9xPollButton (uint32, bool *)
+{
+	return (false);
+}
+
+bool S9xPollPointer (uint32, int16 *, int16 *)
+{
+	return (false);
+}
+
+bool S9xPollAxis (uint32, int16 *)
+{
+	return (false);
+}
+
+bool8 S9xOpenSnapshotFile (const char *filename, bool8 read_only, STREAM *file)
+{
+	return ((*file = OPEN_STREAM(filename, read_only ? "rb" : "wb")) != NULL);
+}
+
+void S9xCloseSnapshotFile (STREAM file)
+{
+	CLOSE_STREAM(file);
+}
+
+std::string S9xGetDirectory (enum s9x_getdirtype)
+{
+	SplitPath path = splitpath(Memory.ROMFilename);
+
+	return (path.dir.empty() ? std::string(".") : path.dir);
+}
+
+std::string S9xGetFilenameInc (std::string ex, enum s9x_getdirtype dirtype)
+{
+	return (S9xGetFilename(ex, dirtype));
+}
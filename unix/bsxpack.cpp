@@ -0,0 +1,210 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+/*
+ * bsxpack: packs the Satellaview broadcast files of a directory
+ * (BSXHHHH-D.bin, one file per channel and packet count) into the single
+ * BSX.pak archive the BS-X emulation maps at startup.
+ *
+ *   bsxpack [-o archive] dir
+ *
+ * The archive is written to dir/BSX.pak unless -o is given. Once it exists,
+ * the loose files in that directory are no longer read.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <dirent.h>
+#include "snes9x.h"
+#include "bsx.h"
+
+struct SPackEntry
+{
+	uint16		channel;
+	uint8		count;
+	std::string	path;
+	uint32		offset;
+	uint32		size;
+};
+
+
+static void Usage (void)
+{
+	fprintf(stderr, "usage: bsxpack [-o archive] dir\n"
+					"  -o <file>          write the archive here instead of dir/" BSX_ARCHIVE_NAME "\n");
+	exit(1);
+}
+
+static bool EntryLess (const SPackEntry &a, const SPackEntry &b)
+{
+	return (a.channel != b.channel ? a.channel < b.channel : a.count < b.count);
+}
+
+// Accepts exactly the names S9xBSXSetStream1/2 would open: BSX%04X-%d.bin
+static bool ParseName (const char *name, uint16 &channel, uint8 &count)
+{
+	unsigned	c, n;
+	char		tail[8];
+
+	if (strlen(name) < 13 || strncmp(name, "BSX", 3) || name[7] != '-')
+		return (false);
+
+	if (sscanf(name, "BSX%4X-%u%7s", &c, &n, tail) != 3 || strcmp(tail, ".bin") || n > 255)
+		return (false);
+
+	char	expected[32];
+	snprintf(expected, sizeof(expected), "BSX%04X-%u.bin", c, n);
+	if (strcmp(expected, name))
+		return (false);
+
+	channel = c;
+	count = n;
+
+	return (true);
+}
+
+static void PutLE (uint8 *p, uint32 value, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		p[i] = (uint8) (value >> (i * 8));
+}
+
+static bool CopyFile (FILE *out, const std::string &path, uint32 &size)
+{
+	FILE	*fp = fopen(path.c_str(), "rb");
+	if (!fp)
+	{
+		fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+		return (false);
+	}
+
+	uint8	buffer[65536];
+	size_t	n;
+
+	size = 0;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+	{
+		if (fwrite(buffer, 1, n, out) != n)
+		{
+			fclose(fp);
+			return (false);
+		}
+
+		size += n;
+	}
+
+	fclose(fp);
+
+	return (true);
+}
+
+int main (int argc, char **argv)
+{
+	const char	*dir_name = NULL, *out_name = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			out_name = argv[++i];
+		else
+		if (argv[i][0] != '-' && !dir_name)
+			dir_name = argv[i];
+		else
+			Usage();
+	}
+
+	if (!dir_name)
+		Usage();
+
+	std::string	output = out_name ? out_name : std::string(dir_name) + "/" BSX_ARCHIVE_NAME;
+
+	DIR	*dir = opendir(dir_name);
+	if (!dir)
+	{
+		fprintf(stderr, "Couldn't open directory %s: %s\n", dir_name, strerror(errno));
+		return (1);
+	}
+
+	std::vector<SPackEntry>	entries;
+	struct dirent			*dirent;
+
+	while ((dirent = readdir(dir)) != NULL)
+	{
+		SPackEntry	entry;
+
+		if (ParseName(dirent->d_name, entry.channel, entry.count))
+		{
+			entry.path = std::string(dir_name) + "/" + dirent->d_name;
+			entries.push_back(entry);
+		}
+	}
+
+	closedir(dir);
+
+	if (entries.empty())
+	{
+		fprintf(stderr, "No BSXHHHH-D.bin files in %s\n", dir_name);
+		return (1);
+	}
+
+	std::sort(entries.begin(), entries.end(), EntryLess);
+
+	FILE	*fp = fopen(output.c_str(), "wb");
+	if (!fp)
+	{
+		fprintf(stderr, "%s: %s\n", output.c_str(), strerror(errno));
+		return (1);
+	}
+
+	// The data follows the index; write a placeholder index first and fill it in afterwards
+	std::vector<uint8>	index(BSX_ARCHIVE_HEADER_SIZE + entries.size() * BSX_ARCHIVE_ENTRY_SIZE);
+	uint32				offset = (uint32) index.size();
+
+	fwrite(&index[0], 1, index.size(), fp);
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (!CopyFile(fp, entries[i].path, entries[i].size))
+		{
+			fclose(fp);
+			remove(output.c_str());
+			return (1);
+		}
+
+		entries[i].offset = offset;
+		offset += entries[i].size;
+	}
+
+	memcpy(&index[0], BSX_ARCHIVE_MAGIC, 8);
+	PutLE(&index[8], BSX_ARCHIVE_VERSION, 4);
+	PutLE(&index[12], (uint32) entries.size(), 4);
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		uint8	*p = &index[BSX_ARCHIVE_HEADER_SIZE + i * BSX_ARCHIVE_ENTRY_SIZE];
+
+		PutLE(p, entries[i].channel, 2);
+		p[2] = entries[i].count;
+		p[3] = 0;
+		PutLE(p + 4, entries[i].offset, 4);
+		PutLE(p + 8, entries[i].size, 4);
+	}
+
+	if (fseek(fp, 0, SEEK_SET) || fwrite(&index[0], 1, index.size(), fp) != index.size() || fclose(fp))
+	{
+		fprintf(stderr, "%s: %s\n", output.c_str(), strerror(errno));
+		remove(output.c_str());
+		return (1);
+	}
+
+	printf("%s: %d files, %u bytes\n", output.c_str(), (int) entries.size(), offset);
+
+	return (0);
+}
@@ -0,0 +1,466 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+/*
+ * spc2wav: renders .spc snapshots to 32 kHz 16-bit stereo WAV files, as fast
+ * as the SMP and DSP can run, using only the APU core.
+ *
+ *   spc2wav [-seconds n] [-interp name] [-jobs n] [-o dir] file.spc|dir ...
+ *   spc2wav -compare [-seconds n] [-interp name] [-jobs n] file.spc|dir ...
+ *
+ * Directories are scanned for .spc files. -compare renders every file twice,
+ * once through the decoded SPC700 runs and once with Settings.StepSMPOpcodes,
+ * and reports files whose output or final SMP/DSP state differ. The APU core keeps its state in
+ * globals, so files are spread over one worker process per core instead of
+ * threads.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "snes9x.h"
+#include "apu/apu.h"
+#include "apu/resampler.h"
+#include "apu/bapu/snes/snes.hpp"
+#include "msu1.h"
+
+// The pieces of the emulator the APU core refers to
+struct SSettings	Settings;
+
+namespace SNES
+{
+	CPU	cpu;
+}
+
+void S9xMSU1Generate (size_t)
+{
+}
+
+#ifdef DEBUGGER
+void S9xTraceMessage (const char *)
+{
+}
+#endif
+
+#define SPC_RAM_OFFSET	0x100
+#define SPC_DSP_OFFSET	0x10100
+#define CHUNK_SAMPLES	4096
+
+static const struct
+{
+	const char	*name;
+	int			method;
+}	Interpolations[] =
+{
+	{ "none",     DSP_INTERPOLATION_NONE     },
+	{ "linear",   DSP_INTERPOLATION_LINEAR   },
+	{ "gaussian", DSP_INTERPOLATION_GAUSSIAN },
+	{ "cubic",    DSP_INTERPOLATION_CUBIC    },
+	{ "sinc",     DSP_INTERPOLATION_SINC     }
+};
+
+#define INTERPOLATION_COUNT	((int) (sizeof(Interpolations) / sizeof(Interpolations[0])))
+
+
+static void Usage (void)
+{
+	fprintf(stderr, "usage: spc2wav [options] file.spc|dir ...\n"
+					"  -seconds <n>       length to render (default 30)\n"
+					"  -interp <name>     none, linear, gaussian (default), cubic or sinc\n"
+					"  -jobs <n>          worker processes (default: one per core)\n"
+					"  -o <dir>           write WAV files here instead of next to the input\n"
+					"  -compare           check decoded SPC700 runs against op_step, write nothing\n");
+	exit(1);
+}
+
+static bool HasSPCExtension (const std::string &name)
+{
+	return (name.size() > 4 && !strcasecmp(name.c_str() + name.size() - 4, ".spc"));
+}
+
+static void AddInput (std::vector<std::string> &files, const char *path)
+{
+	struct stat	st;
+
+	if (stat(path, &st) || !S_ISDIR(st.st_mode))
+	{
+		files.push_back(path);
+		return;
+	}
+
+	DIR	*dir = opendir(path);
+	if (!dir)
+	{
+		fprintf(stderr, "Couldn't open directory %s: %s\n", path, strerror(errno));
+		return;
+	}
+
+	std::vector<std::string>	found;
+	struct dirent				*entry;
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (HasSPCExtension(entry->d_name))
+			found.push_back(std::string(path) + "/" + entry->d_name);
+	}
+
+	closedir(dir);
+
+	std::sort(found.begin(), found.end());
+	files.insert(files.end(), found.begin(), found.end());
+}
+
+static std::string OutputName (const std::string &input, const char *out_dir)
+{
+	std::string	name = input;
+
+	if (out_dir)
+	{
+		size_t	slash = name.rfind('/');
+		if (slash != std::string::npos)
+			name = name.substr(slash + 1);
+		name = std::string(out_dir) + "/" + name;
+	}
+
+	if (HasSPCExtension(name))
+		name.resize(name.size() - 4);
+
+	return (name + ".wav");
+}
+
+static void PutLE (uint8 *p, uint32 value, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		p[i] = (uint8) (value >> (i * 8));
+}
+
+static void WriteWAVHeader (FILE *fp, uint32 sample_frames)
+{
+	uint8	header[44];
+	uint32	data_size = sample_frames * 4;
+
+	memcpy(header, "RIFF", 4);
+	PutLE(header + 4, 36 + data_size, 4);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	PutLE(header + 16, 16, 4);
+	PutLE(header + 20, 1, 2);			// PCM
+	PutLE(header + 22, 2, 2);			// stereo
+	PutLE(header + 24, 32000, 4);
+	PutLE(header + 28, 32000 * 4, 4);
+	PutLE(header + 32, 4, 2);
+	PutLE(header + 34, 16, 2);
+	memcpy(header + 36, "data", 4);
+	PutLE(header + 40, data_size, 4);
+
+	fwrite(header, 1, sizeof(header), fp);
+}
+
+// Puts the SMP and DSP in the state stored in an SPC file, the reverse of SMP::save_spc
+static bool LoadSPC (const uint8 *spc)
+{
+	if (memcmp(spc, "SNES-SPC700 Sound File Data", 27))
+		return (false);
+
+	const uint8	*ram = spc + SPC_RAM_OFFSET;
+
+	SNES::smp.power();
+	SNES::dsp.power();
+	SNES::cpu.reset();
+
+	memcpy(SNES::smp.apuram, ram, 0x10000);
+
+	SNES::smp.regs.pc   = spc[0x25] | (spc[0x26] << 8);
+	SNES::smp.regs.B.a  = spc[0x27];
+	SNES::smp.regs.x    = spc[0x28];
+	SNES::smp.regs.B.y  = spc[0x29];
+	SNES::smp.regs.p    = spc[0x2a];
+	SNES::smp.regs.sp   = spc[0x2b];
+
+	SNES::smp.status.iplrom_enable = ram[0xf1] & 0x80;
+	SNES::smp.status.dsp_addr = ram[0xf2];
+	SNES::smp.status.ram00f8 = ram[0xf8];
+	SNES::smp.status.ram00f9 = ram[0xf9];
+
+	SNES::smp.timer0.enable = ram[0xf1] & 0x01;
+	SNES::smp.timer1.enable = ram[0xf1] & 0x02;
+	SNES::smp.timer2.enable = ram[0xf1] & 0x04;
+	SNES::smp.timer0.target = ram[0xfa];
+	SNES::smp.timer1.target = ram[0xfb];
+	SNES::smp.timer2.target = ram[0xfc];
+	SNES::smp.timer0.stage3_ticks = ram[0xfd] & 15;
+	SNES::smp.timer1.stage3_ticks = ram[0xfe] & 15;
+	SNES::smp.timer2.stage3_ticks = ram[0xff] & 15;
+
+	// The ports hold what the S-CPU last wrote
+	memcpy(SNES::cpu.registers, ram + 0xf4, 4);
+
+	// load() only fills the registers the SPC700 reads back; write them all
+	// so the voices see them too
+	SNES::dsp.spc_dsp.load(spc + SPC_DSP_OFFSET);
+	for (int i = 0; i < SNES::SPC_DSP::register_count; i++)
+		SNES::dsp.spc_dsp.write(i, spc[SPC_DSP_OFFSET + i]);
+
+	SNES::smp.block_flush();
+
+	return (true);
+}
+
+static bool ReadSPC (const std::string &input, std::vector<uint8> &spc)
+{
+	FILE	*fp = fopen(input.c_str(), "rb");
+	if (!fp)
+	{
+		fprintf(stderr, "%s: %s\n", input.c_str(), strerror(errno));
+		return (false);
+	}
+
+	spc.resize(SPC_FILE_SIZE);
+	size_t	size = fread(&spc[0], 1, SPC_FILE_SIZE, fp);
+	fclose(fp);
+
+	if (size < SPC_DSP_OFFSET + SNES::SPC_DSP::register_count || !LoadSPC(&spc[0]))
+	{
+		fprintf(stderr, "%s: not an SPC file\n", input.c_str());
+		return (false);
+	}
+
+	return (true);
+}
+
+// Runs the loaded snapshot for total sample frames and appends the output to samples
+static void RenderSamples (uint32 total, std::vector<int16> &samples)
+{
+	Resampler			ring(CHUNK_SAMPLES * 2 * 2);
+	std::vector<int16>	buffer(CHUNK_SAMPLES * 2 + 2);
+
+	ring.clear();
+	SNES::dsp.spc_dsp.set_output(&ring);
+
+	for (uint32 done = 0; done < total; )
+	{
+		uint32	frames = std::min<uint32>(CHUNK_SAMPLES, total - done);
+
+		// 32 SMP clocks per output sample
+		SNES::smp.clock -= frames * 32;
+		SNES::smp.enter();
+		SNES::dsp.synchronize();
+
+		// the SMP may overshoot by part of an instruction, so there can be
+		// one sample more than asked for
+		int	avail = std::min<int>(ring.space_filled(), (total - done) * 2);
+		ring.pull(&buffer[0], avail);
+
+		samples.insert(samples.end(), buffer.begin(), buffer.begin() + avail);
+		done += avail / 2;
+	}
+}
+
+static bool Render (const std::string &input, const std::string &output, int seconds)
+{
+	std::vector<uint8>	spc;
+	std::vector<int16>	samples;
+
+	if (!ReadSPC(input, spc))
+		return (false);
+
+	FILE	*fp = fopen(output.c_str(), "wb");
+	if (!fp)
+	{
+		fprintf(stderr, "%s: %s\n", output.c_str(), strerror(errno));
+		return (false);
+	}
+
+	uint32	total = seconds * 32000;
+	WriteWAVHeader(fp, total);
+
+	RenderSamples(total, samples);
+
+#ifndef LSB_FIRST
+	for (size_t i = 0; i < samples.size(); i++)
+		samples[i] = (int16) (((uint16) samples[i] >> 8) | ((uint16) samples[i] << 8));
+#endif
+
+	fwrite(&samples[0], 2, samples.size(), fp);
+	fclose(fp);
+
+	return (true);
+}
+
+// Renders the file with and without the decoded SPC700 runs; both must give
+// the same samples and leave the SMP and DSP in the same state
+static bool Compare (const std::string &input, int seconds)
+{
+	std::vector<uint8>	spc;
+	std::vector<int16>	samples[2];
+	std::vector<uint8>	state[2];
+
+	if (!ReadSPC(input, spc))
+		return (false);
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		Settings.StepSMPOpcodes = pass;
+
+		LoadSPC(&spc[0]);
+		RenderSamples(seconds * 32000, samples[pass]);
+
+		state[pass].resize(SPC_SAVE_STATE_BLOCK_SIZE);
+		uint8	*ptr = &state[pass][0];
+		SNES::smp.save_state(&ptr);
+		SNES::dsp.save_state(&ptr);
+		state[pass].resize(ptr - &state[pass][0]);
+	}
+
+	Settings.StepSMPOpcodes = FALSE;
+
+	size_t	n = 0;
+	while (n < samples[0].size() && n < samples[1].size() && samples[0][n] == samples[1][n])
+		n++;
+
+	if (n < samples[0].size() || n < samples[1].size())
+	{
+		printf("%s: output differs from sample frame %u\n", input.c_str(), (uint32) (n / 2));
+		return (false);
+	}
+
+	if (state[0] != state[1])
+	{
+		printf("%s: SMP/DSP state differs\n", input.c_str());
+		return (false);
+	}
+
+	printf("%s: identical\n", input.c_str());
+
+	return (true);
+}
+
+int main (int argc, char **argv)
+{
+	std::vector<std::string>	files;
+	const char					*out_dir = NULL;
+	int							seconds = 30, jobs = 0;
+	bool						compare = false;
+
+	memset(&Settings, 0, sizeof(Settings));
+	Settings.InterpolationMethod = DSP_INTERPOLATION_GAUSSIAN;
+	Settings.SkipSMPIdleLoops = TRUE;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-seconds") && i + 1 < argc)
+			seconds = atoi(argv[++i]);
+		else
+		if (!strcmp(argv[i], "-jobs") && i + 1 < argc)
+			jobs = atoi(argv[++i]);
+		else
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			out_dir = argv[++i];
+		else
+		if (!strcmp(argv[i], "-compare"))
+			compare = true;
+		else
+		if (!strcmp(argv[i], "-interp") && i + 1 < argc)
+		{
+			int	n;
+
+			i++;
+			for (n = 0; n < INTERPOLATION_COUNT; n++)
+			{
+				if (!strcasecmp(argv[i], Interpolations[n].name))
+					break;
+			}
+
+			if (n == INTERPOLATION_COUNT)
+			{
+				fprintf(stderr, "Unknown interpolation '%s'.\n", argv[i]);
+				Usage();
+			}
+
+			Settings.InterpolationMethod = Interpolations[n].method;
+		}
+		else
+		if (argv[i][0] != '-')
+			AddInput(files, argv[i]);
+		else
+			Usage();
+	}
+
+	if (files.empty() || seconds <= 0)
+		Usage();
+
+	if (jobs <= 0)
+		jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs > (int) files.size())
+		jobs = (int) files.size();
+	if (jobs < 1)
+		jobs = 1;
+
+	std::vector<pid_t>	workers;
+	int					status = 0;
+
+	for (int job = 0; job < jobs; job++)
+	{
+		pid_t	pid = jobs > 1 ? fork() : 0;
+
+		if (pid < 0)
+		{
+			perror("fork");
+			status = 1;
+			break;
+		}
+
+		if (pid > 0)
+		{
+			workers.push_back(pid);
+			continue;
+		}
+
+		int	failed = 0;
+
+		for (size_t n = job; n < files.size(); n += jobs)
+		{
+			if (compare)
+			{
+				if (!Compare(files[n], seconds))
+					failed++;
+				continue;
+			}
+
+			std::string	output = OutputName(files[n], out_dir);
+
+			if (Render(files[n], output, seconds))
+				printf("%s -> %s\n", files[n].c_str(), output.c_str());
+			else
+				failed++;
+		}
+
+		if (jobs > 1)
+		{
+			fflush(stdout);
+			_exit(failed ? 1 : 0);
+		}
+
+		return (failed ? 1 : 0);
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		int	result;
+
+		if (waitpid(workers[i], &result, 0) < 0 || !WIFEXITED(result) || WEXITSTATUS(result))
+			status = 1;
+	}
+
+	return (status);
+}
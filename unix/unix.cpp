@@ -59,6 +59,7 @@
 #include "debug.h"
 #endif
 #include "statemanager.h"
+#include "perfcounters.h"
 
 #ifdef NETPLAY_SUPPORT
 #ifdef _DEBUG
@@ -87,7 +88,8 @@ static const char	*s9x_base_dir        = NULL,
 					*rom_filename        = NULL,
 					*snapshot_filename   = NULL,
 					*play_smv_filename   = NULL,
-					*record_smv_filename = NULL;
+					*record_smv_filename = NULL,
+					*perf_csv_filename   = NULL;
 
 static char		default_dir[PATH_MAX + 1];
 
@@ -116,6 +118,7 @@ struct SUnixSettings
 	uint32	SoundFragmentSize;
 	uint32	rewindBufferSize;
 	uint32	rewindGranularity;
+	uint32	PerfCSVFrames;
 };
 
 struct SoundStatus
@@ -376,6 +379,10 @@ void S9xExtraUsage (void)
 	S9xMessage(S9X_INFO, S9X_USAGE, "-dumpstreams                    Save audio/video data to disk");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-dumpmaxframes <num>            Stop emulator after saving specified number of");
 	S9xMessage(S9X_INFO, S9X_USAGE, "                                frames (use with -dumpstreams)");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-coverage                       Record ROM code/data usage, saved as .cdl and");
+	S9xMessage(S9X_INFO, S9X_USAGE, "                                .hits.csv on exit");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-perfcsv <filename>             Write performance counters to a CSV file");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-perfcsvframes <num>            Frames summed into each CSV row (default 60)");
 	S9xMessage(S9X_INFO, S9X_USAGE, "");
 
 	S9xMessage(S9X_INFO, S9X_USAGE, "-rwbuffersize                   Rewind buffer size in MB");
@@ -481,6 +488,25 @@ void S9xParseArg (char **argv, int &i, int argc)
 	if (!strcasecmp(argv[i], "-dumpmaxframes"))
 		Settings.DumpStreamsMaxFrames = atoi(argv[++i]);
 	else
+	if (!strcasecmp(argv[i], "-coverage"))
+		Settings.CodeCoverage = TRUE;
+	else
+	if (!strcasecmp(argv[i], "-perfcsv"))
+	{
+		if (i + 1 < argc)
+			perf_csv_filename = argv[++i];
+		else
+			S9xUsage();
+	}
+	else
+	if (!strcasecmp(argv[i], "-perfcsvframes"))
+	{
+		if (i + 1 < argc)
+			unixSettings.PerfCSVFrames = atoi(argv[++i]);
+		else
+			S9xUsage();
+	}
+	else
 	if (!strcasecmp(argv[i], "-rwbuffersize"))
 	{
 		if (i + 1 < argc)
@@ -780,7 +806,9 @@ bool8 S9xInitUpdate (void)
 
 bool8 S9xDeinitUpdate (int width, int height)
 {
+	uint64	start = S9xPerfTimestamp();
 	S9xPutImage(width, height);
+	S9xPerfAddTime(PERF_TIME_VIDEO, start);
 	return (TRUE);
 }
 
@@ -1405,6 +1433,8 @@ void S9xSamplesAvailable(void *data)
     }
 #endif
 
+    uint64 start = S9xPerfTimestamp();
+
 #ifndef ALSA
     S9xMixSamples(sound_buffer, samples_to_write);
     s_AudioOutput->Write(sound_buffer, samples_to_write * 2);
@@ -1434,6 +1464,8 @@ void S9xSamplesAvailable(void *data)
         }
     }
 #endif //ALSA
+
+    S9xPerfAddTime(PERF_TIME_AUDIO, start);
 #endif //NOSOUND
 }
 
@@ -1600,6 +1632,12 @@ void S9xExit (void)
 	Memory.SaveSRAM(S9xGetFilename(".srm", SRAM_DIR).c_str());
 	S9xResetSaveTimer(FALSE);
 	S9xSaveCheatFile(S9xGetFilename(".cht", CHEAT_DIR));
+	if (Settings.CodeCoverage)
+	{
+		S9xCoverageSaveCDL(S9xGetFilename(".cdl", LOG_DIR).c_str());
+		S9xCoverageSaveHeatmap(S9xGetFilename(".hits.csv", LOG_DIR).c_str());
+	}
+	S9xPerfCloseCSV();
 	S9xUnmapAllControls();
 	S9xDeinitDisplay();
 	Memory.Deinit();
@@ -1666,6 +1704,7 @@ int main (int argc, char **argv)
 
 	unixSettings.rewindBufferSize = 0;
 	unixSettings.rewindGranularity = 1;
+	unixSettings.PerfCSVFrames = 60;
 
 	memset(&so, 0, sizeof(so));
 
@@ -1833,6 +1872,9 @@ int main (int argc, char **argv)
 		}
 	}
 
+	if (perf_csv_filename && !S9xPerfOpenCSV(perf_csv_filename, unixSettings.PerfCSVFrames))
+		fprintf(stderr, "Couldn't open %s for writing.\n", perf_csv_filename);
+
 	S9xGraphicsMode();
 
 	sprintf(String, "\"%s\" %s: %s", Memory.ROMName, TITLE, VERSION);
@@ -1902,7 +1944,9 @@ int main (int argc, char **argv)
 			else if(IPPU.TotalEmulatedFrames % unixSettings.rewindGranularity == 0)
 				stateMan.push();
 
+			uint64	start = S9xPerfTimestamp();
 			S9xMainLoop();
+			S9xPerfAddTime(PERF_TIME_FRAME, start);
 		}
                 if (Settings.Paused && frame_advance)
                 {
@@ -1936,6 +1980,8 @@ int main (int argc, char **argv)
 			usleep(100000);
 		}
 
+		uint64	start = S9xPerfTimestamp();
+
 	#ifdef JOYSTICK_SUPPORT
 		if (unixSettings.JoystickEnabled && (JoypadSkip++ & 1) == 0)
 		{
@@ -1946,6 +1992,7 @@ int main (int argc, char **argv)
 	#endif
 
 		S9xProcessEvents(FALSE);
+		S9xPerfAddTime(PERF_TIME_INPUT, start);
 
 	#ifdef DEBUGGER
 		if (!Settings.Paused && !(CPU.Flags & DEBUG_MODE_FLAG))
@@ -92,6 +92,7 @@ struct GUIData
 	Window			window;
 	Image			*image;
 	uint8			*filter_buffer;
+	uint16			*overlay_buffer;
 	uint8			*blit_screen;
 	uint32			blit_screen_pitch;
 	bool8			need_convert;
@@ -390,6 +391,7 @@ const char * S9xParseDisplayConfig (ConfigFile &conf, int pass)
 
 	GUI.no_repeat = !conf.GetBool("Unix/X11::SetKeyRepeat", TRUE);
 	GUI.fullscreen = conf.GetBool("Unix/X11::Fullscreen", FALSE);
+	Settings.MessagesAsOverlay = conf.GetBool("Unix/X11::MessagesAsOverlay", FALSE);
 #ifdef USE_XVIDEO
 	GUI.use_xvideo = conf.GetBool("Unix/X11::Xvideo", FALSE);
 	GUI.maxaspect = conf.GetBool("Unix/X11::MaxAspect", FALSE);
@@ -934,6 +936,10 @@ static void SetupImage (void)
 	if (!GUI.filter_buffer)
 		FatalError("Failed to allocate GUI.filter_buffer.");
 
+	GUI.overlay_buffer = (uint16 *) calloc(MAX_SNES_WIDTH * MAX_SNES_HEIGHT, sizeof(uint16));
+	if (!GUI.overlay_buffer)
+		FatalError("Failed to allocate GUI.overlay_buffer.");
+
 #ifdef USE_XVIDEO
 	if ((GUI.depth == 15 || GUI.depth == 16) && GUI.xv_format != FOURCC_YUY2 && GUI.xv_format != FOURCC_I420)
 #else
@@ -963,6 +969,12 @@ static void TakedownImage (void)
 		GUI.filter_buffer = NULL;
 	}
 
+	if (GUI.overlay_buffer)
+	{
+		free(GUI.overlay_buffer);
+		GUI.overlay_buffer = NULL;
+	}
+
 	if (GUI.image)
 	{
 #ifdef USE_XVIDEO
@@ -1302,7 +1314,18 @@ void S9xPutImage (int width, int height)
 		copyHeight = height;
 		blitFn = S9xBlitPixSimple1x1;
 	}
-	blitFn((uint8 *) GFX.Screen, GFX.Pitch, GUI.blit_screen, GUI.blit_screen_pitch, width, height);
+
+	if (Settings.MessagesAsOverlay)
+	{
+		// the core left the messages out of GFX.Screen, so put them on a copy before filtering
+		for (int y = 0; y < height; y++)
+			memcpy(GUI.overlay_buffer + y * MAX_SNES_WIDTH, (uint8 *) GFX.Screen + y * GFX.Pitch, width * sizeof(uint16));
+
+		S9xDrawOSDOverlay(GUI.overlay_buffer, MAX_SNES_WIDTH);
+		blitFn((uint8 *) GUI.overlay_buffer, MAX_SNES_WIDTH * sizeof(uint16), GUI.blit_screen, GUI.blit_screen_pitch, width, height);
+	}
+	else
+		blitFn((uint8 *) GFX.Screen, GFX.Pitch, GUI.blit_screen, GUI.blit_screen_pitch, width, height);
 
 	if (height < prevHeight)
 	{